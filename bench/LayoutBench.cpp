@@ -0,0 +1,233 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Measures what one relayout costs in `WinMan::tile()` without the X
+// requests: filtering by tag, picking out the tiled windows, computing the
+// layout (mostly from the cache), applying size hints and diffing it against
+// the stored geometry.
+// Also times every layout on its own, after checking its output on random
+// parameters. Exits with 1 if any check fails, `--check` only checks.
+
+#include <LibGeometry.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const char* layout_names[] = { "tile", "monocle", "grid", "centered_master", "dwindle", "deck" };
+
+static void bench(size_t clients)
+{
+    GeometryStore store;
+    std::vector<GeometryStore::Handle> stack;
+    for (size_t i = 0; i < clients; i++) {
+        // Spread over two tags with every eighth one floating, roughly
+        // what a busy session looks like.
+        uint8_t flags = i % 8 == 0 ? GeometryStore::Floating : 0;
+        stack.push_back(store.add(i + 1, { 0, 0 }, { 640, 480 }, 1 << (i % 2), flags));
+
+        // Every fourth one is a terminal, sized in character cells.
+        if (i % 4 == 1) {
+            store.hints[stack.back()] = { 4, 4, 11, 18, 0, 0, 7, 14, 0, 0 };
+            store.set(stack.back(), GeometryStore::Constrained, true);
+        }
+    }
+
+    LayoutParams params { Layout::Tile, 0, 20, 2560, 1420, 0.55, 1, 10, 10, 10, 10, false, 2 };
+
+    std::vector<uint8_t> visible;
+    std::vector<GeometryStore::Handle> tiled;
+    LayoutCache cache(16);
+    size_t changed = 0;
+
+    constexpr int iterations = 20000;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; i++) {
+        // Alternate the viewed tags and master size so the diff has work.
+        unsigned int viewed = i % 2 ? 1 : 3;
+        params.master_size = i % 2 ? 0.55 : 0.6;
+
+        store.filter_by_tags(viewed, visible);
+
+        tiled.clear();
+        for (auto handle : stack) {
+            if (visible[handle] && !store.has(handle, GeometryStore::Floating))
+                tiled.push_back(handle);
+        }
+
+        const LayoutResult& layout = cache.get(params, tiled.size());
+
+        for (size_t j = 0; j < tiled.size(); j++) {
+            auto handle = tiled[j];
+            Size<int> size { layout.width[j], layout.height[j] };
+            if (store.has(handle, GeometryStore::Constrained))
+                size = apply_size_hints(store.hints[handle], size);
+
+            if (store.x[handle] != layout.x[j] || store.y[handle] != layout.y[j] || store.width[handle] != size.width
+                || store.height[handle] != size.height) {
+                store.x[handle] = layout.x[j];
+                store.y[handle] = layout.y[j];
+                store.width[handle] = size.width;
+                store.height[handle] = size.height;
+                changed++;
+            }
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+    // Hit testing runs on every pointer event that needs a window.
+    auto hit_start = std::chrono::steady_clock::now();
+    GeometryStore::Handle hit = GeometryStore::invalid;
+    for (int i = 0; i < iterations; i++)
+        hit ^= store.hit_test({ (i * 37) % 2560, (i * 11) % 1440 }, 1);
+    auto hit_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - hit_start);
+
+    printf("%5zu clients: %8.1f ns/relayout, %8.1f ns/hit test (%zu windows moved, %lu/%lu cache hits/misses, %u)\n",
+        clients, static_cast<double>(elapsed.count()) / iterations,
+        static_cast<double>(hit_elapsed.count()) / iterations, changed, cache.hits(), cache.misses(), hit);
+}
+
+// A window's rectangle with its border.
+struct Outer {
+    int x, y, width, height;
+
+    bool operator==(const Outer&) const = default;
+};
+
+// Windows the area has no room for (too many, or gaps too big) are shrunk to
+// a pixel wherever their cell starts, and left out of the checks.
+static bool clamped(const LayoutResult& layout, size_t i)
+{
+    return layout.width[i] == 1 || layout.height[i] == 1;
+}
+
+// Monocle and deck put windows on top of each other on purpose.
+static bool stacks_windows(Layout layout)
+{
+    return layout == Layout::Monocle || layout == Layout::Deck;
+}
+
+// Every window at least a pixel big and, border included, inside the tiled
+// area. No two overlap, unless the layout stacks them, in which case they
+// share the exact same spot. Without gaps, the windows cover the whole area.
+// Returns the number of failed checks.
+static size_t check(const LayoutParams& params, size_t n, const LayoutResult& layout)
+{
+    size_t bad = 0;
+    bool any_clamped = false;
+    std::vector<Outer> outers;
+    for (size_t i = 0; i < n; i++) {
+        if (layout.width[i] < 1 || layout.height[i] < 1) {
+            bad++;
+            continue;
+        }
+        if (clamped(layout, i)) {
+            any_clamped = true;
+            continue;
+        }
+
+        Outer outer { layout.x[i], layout.y[i], layout.width[i] + 2 * params.border,
+            layout.height[i] + 2 * params.border };
+        if (outer.x < params.x || outer.y < params.y || outer.x + outer.width > params.x + params.width
+            || outer.y + outer.height > params.y + params.height)
+            bad++;
+
+        bool stacked = false;
+        for (const Outer& other : outers) {
+            if (stacks_windows(params.layout) && outer == other) {
+                stacked = true;
+                break;
+            }
+            if (outer.x < other.x + other.width && other.x < outer.x + outer.width
+                && outer.y < other.y + other.height && other.y < outer.y + outer.height)
+                bad++;
+        }
+        if (!stacked)
+            outers.push_back(outer);
+    }
+
+    bool gapless = !params.inner_gap_h && !params.inner_gap_v && !params.outer_gap_h && !params.outer_gap_v;
+    if (gapless && n && !any_clamped && !bad) {
+        // Disjoint and inside, so they cover it if their areas add up.
+        long covered = 0;
+        for (const Outer& outer : outers)
+            covered += static_cast<long>(outer.width) * outer.height;
+        if (covered != static_cast<long>(params.width) * params.height)
+            bad++;
+    }
+    return bad;
+}
+
+// Returns the number of failed checks.
+static size_t check_layouts(bool time)
+{
+    std::mt19937 random(1);
+    LayoutResult layout;
+    size_t total_bad = 0;
+
+    for (unsigned int l = 0; l < static_cast<unsigned int>(Layout::Count); l++) {
+        // Random parameters first, so a layout that misplaces windows for
+        // some corner of them shows up. A quarter without any gaps, for the
+        // coverage check.
+        size_t bad = 0;
+        for (int i = 0; i < 10000; i++) {
+            bool gapless = i % 4 == 0;
+            auto gap = [&] { return gapless ? 0 : static_cast<int>(random() % 20); };
+            LayoutParams params {
+                static_cast<Layout>(l),
+                static_cast<int>(random() % 100),
+                static_cast<int>(random() % 100),
+                static_cast<int>(200 + random() % 3000),
+                static_cast<int>(200 + random() % 2000),
+                0.05f + (random() % 90) / 100.0f,
+                static_cast<unsigned int>(random() % 4),
+                gap(),
+                gap(),
+                gap(),
+                gap(),
+                random() % 2 == 0,
+                static_cast<int>(random() % 6),
+            };
+            size_t n = random() % 40;
+            arrange(params, n, layout);
+            size_t failed = check(params, n, layout);
+            if (failed && !bad)
+                printf("%s: %zu failed checks for %zu windows in %dx%d+%d+%d, first of the kind\n", layout_names[l],
+                    failed, n, params.width, params.height, params.x, params.y);
+            bad += failed;
+        }
+        total_bad += bad;
+
+        printf("%16s:", layout_names[l]);
+        if (time) {
+            LayoutParams params { static_cast<Layout>(l), 0, 20, 2560, 1420, 0.55, 1, 10, 10, 10, 10, false, 2 };
+            constexpr int iterations = 20000;
+            for (size_t n : { 10, 100, 1000 }) {
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < iterations; i++) {
+                    params.master_size = i % 2 ? 0.55 : 0.6;
+                    arrange(params, n, layout);
+                }
+                auto elapsed
+                    = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+                printf(" %8.1f ns at %4zu,", static_cast<double>(elapsed.count()) / iterations, n);
+            }
+        }
+        printf(" %zu failed checks\n", bad);
+    }
+    return total_bad;
+}
+
+int main(int argc, char** argv)
+{
+    bool only_check = argc == 2 && !strcmp(argv[1], "--check");
+    if (!only_check) {
+        for (size_t clients : { 10, 100, 1000 })
+            bench(clients);
+    }
+    return check_layouts(!only_check) ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+// Opens, maps, resizes and destroys windows at a steady rate against a
+// running pluswm and measures how long the WM takes to tile and focus each
+// new window, plus the CPU time and memory the WM used meanwhile. Results go
+// to stdout as one JSON object. See `meta/bench.sh`, which sets up Xvfb and
+// the WM around it.
+//
+//   stress-client <wm pid> [windows] [windows per second] [kept open]
+
+#include <X11/Xlib.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Tracked {
+    Clock::time_point mapped_at;
+    bool configured { false };
+    bool tiled { false };
+    bool focused { false };
+};
+
+struct Usage {
+    double cpu_ms { 0 };
+    long rss_kb { 0 };
+    long peak_rss_kb { 0 };
+};
+
+static Usage wm_usage(pid_t pid)
+{
+    Usage usage;
+
+    std::string path = "/proc/" + std::to_string(pid) + "/stat";
+    if (FILE* file = fopen(path.c_str(), "r")) {
+        // Fields 14 and 15 are utime and stime, the name in field 2 may
+        // contain spaces but ends at the last ')'.
+        char buffer[1024];
+        size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+        buffer[length] = 0;
+        fclose(file);
+
+        if (char* fields = strrchr(buffer, ')')) {
+            unsigned long utime, stime;
+            if (sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2)
+                usage.cpu_ms = (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+        }
+    }
+
+    path = "/proc/" + std::to_string(pid) + "/status";
+    if (FILE* file = fopen(path.c_str(), "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            sscanf(line, "VmRSS: %ld", &usage.rss_kb);
+            sscanf(line, "VmHWM: %ld", &usage.peak_rss_kb);
+        }
+        fclose(file);
+    }
+
+    return usage;
+}
+
+static void print_latencies(const char* name, std::vector<double> samples, bool last)
+{
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        return samples.empty() ? 0 : samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+    };
+
+    printf("  \"%s\": { \"count\": %zu, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f }%s\n",
+        name, samples.size(), percentile(0.5), percentile(0.95), percentile(0.99),
+        samples.empty() ? 0 : samples.back(), last ? "" : ",");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <wm pid> [windows] [windows per second] [kept open]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    pid_t wm_pid = atoi(argv[1]);
+    int total = argc > 2 ? atoi(argv[2]) : 2000;
+    int rate = argc > 3 ? atoi(argv[3]) : 200;
+    size_t kept_open = argc > 4 ? atoi(argv[4]) : 16;
+
+    Display* display = XOpenDisplay(nullptr);
+    if (!display) {
+        fprintf(stderr, "Could not open the display\n");
+        return EXIT_FAILURE;
+    }
+    Window root = DefaultRootWindow(display);
+
+    std::unordered_map<Window, Tracked> tracked;
+    std::deque<Window> open;
+    std::vector<double> tile_latencies, focus_latencies;
+    int created = 0;
+    unsigned long configures = 0;
+
+    auto ms_since = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    Usage before = wm_usage(wm_pid);
+    auto start = Clock::now();
+    auto interval = std::chrono::nanoseconds(1000000000 / std::max(rate, 1));
+    auto next = start;
+    // After the last window, give the WM a moment to catch up.
+    auto deadline = Clock::time_point::max();
+    auto finished = start;
+
+    while (Clock::now() < deadline) {
+        auto now = Clock::now();
+        while (created < total && now >= next) {
+            // 1x1 at the origin, so any ConfigureNotify with another geometry
+            // is the WM's doing.
+            XSetWindowAttributes wa;
+            wa.event_mask = StructureNotifyMask | FocusChangeMask;
+            Window window = XCreateWindow(display, root, 0, 0, 1, 1, 0, CopyFromParent, InputOutput, CopyFromParent,
+                CWEventMask, &wa);
+            XMapWindow(display, window);
+            tracked[window].mapped_at = Clock::now();
+            open.push_back(window);
+            created++;
+
+            // Every other window asks to be resized the way clients
+            // do on startup, the WM has to answer that too.
+            if (created % 2 == 0) {
+                XResizeWindow(display, window, 300, 200);
+                configures++;
+            }
+
+            if (open.size() > kept_open) {
+                XDestroyWindow(display, open.front());
+                tracked.erase(open.front());
+                open.pop_front();
+            }
+
+            next += interval;
+            if (created == total) {
+                finished = Clock::now();
+                deadline = finished + std::chrono::seconds(2);
+            }
+        }
+        XFlush(display);
+
+        auto wait = created < total ? next - Clock::now() : deadline - Clock::now();
+        pollfd fd { ConnectionNumber(display), POLLIN, 0 };
+        if (!XPending(display))
+            poll(&fd, 1, std::max<long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(wait).count()));
+
+        while (XPending(display)) {
+            XEvent e;
+            XNextEvent(display, &e);
+
+            auto it = tracked.find(e.xany.window);
+            if (it == tracked.end())
+                continue;
+            Tracked& window = it->second;
+
+            switch (e.type) {
+            case ConfigureNotify:
+                if (e.xconfigure.width != 1 || e.xconfigure.height != 1)
+                    window.configured = true;
+                break;
+            case MapNotify:
+                // The WM tiles before it maps, so by now the geometry is
+                // final.
+                if (!window.tiled && window.configured) {
+                    window.tiled = true;
+                    tile_latencies.push_back(ms_since(window.mapped_at));
+                }
+                break;
+            case FocusIn:
+                if (!window.focused) {
+                    window.focused = true;
+                    focus_latencies.push_back(ms_since(window.mapped_at));
+                }
+                break;
+            }
+        }
+    }
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(finished - start).count();
+    Usage after = wm_usage(wm_pid);
+
+    for (Window window : open)
+        XDestroyWindow(display, window);
+    XCloseDisplay(display);
+
+    printf("{\n");
+    printf("  \"windows\": %d,\n", created);
+    printf("  \"configure_requests\": %lu,\n", configures);
+    printf("  \"windows_per_second\": %.1f,\n", created * 1000.0 / elapsed_ms);
+    printf("  \"wm_cpu_ms\": %.1f,\n", after.cpu_ms - before.cpu_ms);
+    printf("  \"wm_rss_kb\": %ld,\n", after.rss_kb);
+    printf("  \"wm_peak_rss_kb\": %ld,\n", after.peak_rss_kb);
+    print_latencies("map_to_tiled", tile_latencies, false);
+    print_latencies("map_to_focused", focus_latencies, true);
+    printf("}\n");
+
+    return EXIT_SUCCESS;
+}
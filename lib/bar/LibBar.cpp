@@ -0,0 +1,252 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibBar.h>
+#include <algorithm>
+#include <glog/logging.h>
+
+Bar::Bar(Display* dpy, Window root, Position<int> pos, int width, const char* font_name,
+    const std::vector<std::string>& tag_names)
+    : m_display(dpy)
+    , m_width(width)
+    , m_tag_names(tag_names)
+{
+    m_font = XLoadQueryFont(m_display, font_name);
+    if (!m_font) {
+        LOG(WARNING) << "Could not load font `" << font_name << "`, falling back to `fixed`";
+        m_font = CHECK_NOTNULL(XLoadQueryFont(m_display, "fixed"));
+    }
+
+    // Fill the glyph cache once, XTextWidth() would do the same lookups on
+    // every call.
+    short default_width = m_font->max_bounds.width;
+    m_glyph_widths.fill(default_width);
+    if (m_font->per_char) {
+        for (unsigned int c = m_font->min_char_or_byte2; c <= std::min(m_font->max_char_or_byte2, 255u); c++)
+            m_glyph_widths[c] = m_font->per_char[c - m_font->min_char_or_byte2].width;
+    }
+
+    m_padding = std::max(2, (m_font->ascent + m_font->descent) / 4);
+    m_height = m_font->ascent + m_font->descent + 2 * m_padding;
+
+    for (const auto& name : m_tag_names)
+        m_tag_widths.push_back(text_width(name) + 2 * m_padding);
+
+    int screen = DefaultScreen(m_display);
+
+    XSetWindowAttributes wa;
+    wa.override_redirect = true;
+    wa.background_pixmap = ParentRelative;
+    wa.event_mask = ExposureMask;
+    m_window = XCreateWindow(m_display, root, pos.x, pos.y, m_width, m_height, 0,
+        DefaultDepth(m_display, screen), CopyFromParent, DefaultVisual(m_display, screen),
+        CWOverrideRedirect | CWBackPixmap | CWEventMask, &wa);
+
+    m_pixmap = XCreatePixmap(m_display, root, m_width, m_height, DefaultDepth(m_display, screen));
+    m_gc = XCreateGC(m_display, root, 0, nullptr);
+    XSetFont(m_display, m_gc, m_font->fid);
+
+    m_dirty.fill(true);
+    relayout();
+
+    XMapRaised(m_display, m_window);
+}
+
+Bar::~Bar()
+{
+    XFreeFont(m_display, m_font);
+    XFreeGC(m_display, m_gc);
+    XFreePixmap(m_display, m_pixmap);
+    XDestroyWindow(m_display, m_window);
+}
+
+Window Bar::window() const
+{
+    return m_window;
+}
+
+int Bar::height() const
+{
+    return m_height;
+}
+
+void Bar::set_colors(const BarColors& colors)
+{
+    m_colors = colors;
+    m_dirty.fill(true);
+}
+
+void Bar::set_tags(unsigned int selected, unsigned int occupied, unsigned int urgent)
+{
+    if (selected == m_selected_tags && occupied == m_occupied_tags && urgent == m_urgent_tags)
+        return;
+
+    m_selected_tags = selected;
+    m_occupied_tags = occupied;
+    m_urgent_tags = urgent;
+    m_dirty[TagsSegment] = true;
+}
+
+void Bar::set_layout(std::string_view symbol)
+{
+    if (symbol == m_layout)
+        return;
+
+    int old_width = text_width(m_layout);
+    m_layout = symbol;
+    m_dirty[LayoutSegment] = true;
+
+    if (text_width(m_layout) != old_width)
+        relayout();
+}
+
+void Bar::set_title(std::string_view title)
+{
+    if (title == m_title)
+        return;
+
+    m_title = title;
+    m_dirty[TitleSegment] = true;
+}
+
+void Bar::set_usage(std::string_view usage)
+{
+    if (usage == m_usage)
+        return;
+
+    int old_width = text_width(m_usage);
+    m_usage = usage;
+    m_dirty[UsageSegment] = true;
+
+    if (text_width(m_usage) != old_width)
+        relayout();
+}
+
+void Bar::set_status(std::string_view status)
+{
+    if (status == m_status)
+        return;
+
+    int old_width = text_width(m_status);
+    m_status = status;
+    m_dirty[StatusSegment] = true;
+
+    // The title gives up (or gets back) whatever space the status needs.
+    if (text_width(m_status) != old_width)
+        relayout();
+}
+
+int Bar::text_width(std::string_view text) const
+{
+    int width = 0;
+    for (unsigned char c : text)
+        width += m_glyph_widths[c];
+    return width;
+}
+
+void Bar::relayout()
+{
+    std::array<Extent, SegmentCount> extents;
+
+    int tags_width = 0;
+    for (int width : m_tag_widths)
+        tags_width += width;
+
+    int layout_width = m_layout.empty() ? 0 : text_width(m_layout) + 2 * m_padding;
+    int left_width = tags_width + layout_width;
+    int status_width = std::min(m_width - left_width, text_width(m_status) + 2 * m_padding);
+    int usage_width = m_usage.empty()
+        ? 0
+        : std::min(m_width - left_width - status_width, text_width(m_usage) + 2 * m_padding);
+
+    extents[TagsSegment] = { 0, tags_width };
+    extents[LayoutSegment] = { tags_width, layout_width };
+    extents[StatusSegment] = { m_width - status_width, status_width };
+    extents[UsageSegment] = { m_width - status_width - usage_width, usage_width };
+    extents[TitleSegment] = { left_width, m_width - left_width - status_width - usage_width };
+
+    for (unsigned int i = 0; i < SegmentCount; i++) {
+        if (extents[i].x != m_extents[i].x || extents[i].width != m_extents[i].width)
+            m_dirty[i] = true;
+    }
+
+    m_extents = extents;
+}
+
+void Bar::draw_text(const Extent& extent, int text_x, std::string_view text, unsigned long fg, unsigned long bg)
+{
+    XSetForeground(m_display, m_gc, bg);
+    XFillRectangle(m_display, m_pixmap, m_gc, extent.x, 0, extent.width, m_height);
+
+    // Cut off whatever doesn't fit.
+    int available = extent.x + extent.width - text_x - m_padding;
+    size_t length = 0;
+    for (int width = 0; length < text.size(); length++) {
+        width += m_glyph_widths[static_cast<unsigned char>(text[length])];
+        if (width > available)
+            break;
+    }
+
+    XSetForeground(m_display, m_gc, fg);
+    XDrawString(m_display, m_pixmap, m_gc, text_x, m_padding + m_font->ascent, text.data(), length);
+}
+
+void Bar::draw_segment(Segment segment)
+{
+    const Extent& extent = m_extents[segment];
+
+    switch (segment) {
+    case TagsSegment: {
+        int x = extent.x;
+        for (size_t i = 0; i < m_tag_names.size(); i++) {
+            // Urgent tags stand out by the inverted colors.
+            bool selected = static_cast<bool>(m_selected_tags & (1 << i)) != static_cast<bool>(m_urgent_tags & (1 << i));
+            Extent tag { x, m_tag_widths[i] };
+            draw_text(tag, x + m_padding, m_tag_names[i],
+                selected ? m_colors.selected_foreground : m_colors.foreground,
+                selected ? m_colors.selected_background : m_colors.background);
+
+            // Small square in the corner for tags that have clients.
+            if (m_occupied_tags & (1 << i)) {
+                XSetForeground(m_display, m_gc, selected ? m_colors.selected_foreground : m_colors.foreground);
+                XFillRectangle(m_display, m_pixmap, m_gc, x + 1, 1, m_padding, m_padding);
+            }
+            x += m_tag_widths[i];
+        }
+        break;
+    }
+    case LayoutSegment:
+        draw_text(extent, extent.x + m_padding, m_layout, m_colors.foreground, m_colors.background);
+        break;
+    case TitleSegment:
+        draw_text(extent, extent.x + m_padding, m_title, m_colors.selected_foreground, m_colors.selected_background);
+        break;
+    case UsageSegment:
+        draw_text(extent, extent.x + m_padding, m_usage, m_colors.selected_foreground, m_colors.selected_background);
+        break;
+    case StatusSegment:
+        draw_text(extent, extent.x + m_padding, m_status, m_colors.foreground, m_colors.background);
+        break;
+    case SegmentCount:
+        break;
+    }
+}
+
+void Bar::redraw()
+{
+    for (unsigned int i = 0; i < SegmentCount; i++) {
+        if (!m_dirty[i] || m_extents[i].width <= 0)
+            continue;
+
+        draw_segment(static_cast<Segment>(i));
+        XCopyArea(m_display, m_pixmap, m_window, m_gc, m_extents[i].x, 0, m_extents[i].width, m_height,
+            m_extents[i].x, 0);
+        m_dirty[i] = false;
+    }
+}
+
+void Bar::expose()
+{
+    XCopyArea(m_display, m_pixmap, m_window, m_gc, 0, 0, m_width, m_height, 0, 0);
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <LibUtil.h>
+#include <X11/Xlib.h>
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using Util::Position;
+
+struct BarColors {
+    unsigned long foreground;
+    unsigned long background;
+    unsigned long selected_foreground;
+    unsigned long selected_background;
+};
+
+// A status bar along the top edge of a monitor. Everything is drawn into an
+// off-screen pixmap first and only the segments whose contents changed since
+// the last `redraw()` are drawn and copied to the window.
+class Bar {
+public:
+    Bar(Display*, Window, Position<int>, int, const char*, const std::vector<std::string>&);
+    Bar(const Bar&) = delete;
+    Bar operator=(const Bar&) = delete;
+
+    ~Bar();
+
+    Window window() const;
+    int height() const;
+
+    void set_colors(const BarColors&);
+
+    // Selected, occupied and urgent tags, as bitmasks.
+    void set_tags(unsigned int, unsigned int, unsigned int);
+    void set_layout(std::string_view);
+    void set_title(std::string_view);
+    // Resource usage of the focused client, right of its title.
+    void set_usage(std::string_view);
+    void set_status(std::string_view);
+
+    // Draws the dirty segments and copies them to the window.
+    void redraw();
+
+    // Copies the whole pixmap to the window, nothing is drawn.
+    void expose();
+
+private:
+    enum Segment {
+        TagsSegment = 0,
+        LayoutSegment,
+        TitleSegment,
+        UsageSegment,
+        StatusSegment,
+        SegmentCount
+    };
+
+    struct Extent {
+        int x;
+        int width;
+    };
+
+    int text_width(std::string_view) const;
+
+    void relayout();
+    void draw_text(const Extent&, int, std::string_view, unsigned long, unsigned long);
+    void draw_segment(Segment);
+
+    Display* m_display;
+    Window m_window;
+    Pixmap m_pixmap;
+    GC m_gc;
+    XFontStruct* m_font;
+
+    int m_width;
+    int m_height;
+    int m_padding;
+
+    // Advance width of every single byte glyph, so measuring text never has to
+    // go through Xlib.
+    std::array<short, 256> m_glyph_widths {};
+
+    std::vector<std::string> m_tag_names;
+    std::vector<int> m_tag_widths;
+
+    BarColors m_colors {};
+    unsigned int m_selected_tags { 0 };
+    unsigned int m_occupied_tags { 0 };
+    unsigned int m_urgent_tags { 0 };
+    std::string m_layout;
+    std::string m_title;
+    std::string m_usage;
+    std::string m_status;
+
+    std::array<Extent, SegmentCount> m_extents {};
+    std::array<bool, SegmentCount> m_dirty {};
+};
@@ -0,0 +1,250 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibCgroup.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr const char* mount_point = "/sys/fs/cgroup";
+// How long a spawned child gets to move into its group after the fork.
+static constexpr auto move_in_timeout = std::chrono::seconds(30);
+
+static std::optional<std::string> read_file(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "re");
+    if (!file)
+        return std::nullopt;
+
+    std::string contents;
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents.append(buffer, length);
+    fclose(file);
+    return contents;
+}
+
+static bool write_file(const std::string& path, const std::string& value)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    bool ok = write(fd, value.data(), value.size()) == static_cast<ssize_t>(value.size());
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return ok;
+}
+
+// `key value` lines, as in cpu.stat and cgroup.events.
+static std::optional<uint64_t> read_key(const std::string& path, const char* key)
+{
+    auto contents = read_file(path);
+    if (!contents)
+        return std::nullopt;
+
+    size_t key_length = strlen(key);
+    size_t start = 0;
+    while (start < contents->size()) {
+        size_t end = contents->find('\n', start);
+        if (end == std::string::npos)
+            end = contents->size();
+        if (contents->compare(start, key_length, key) == 0 && (*contents)[start + key_length] == ' ')
+            return strtoull(contents->c_str() + start + key_length + 1, nullptr, 10);
+        start = end + 1;
+    }
+    return std::nullopt;
+}
+
+static void apply_limits(const std::string& path, const CgroupLimits& limits)
+{
+    auto set = [&](const char* file, uint64_t value) {
+        if (value && !write_file(path + "/" + file, std::to_string(value)))
+            LOG(WARNING) << "Could not set " << path << "/" << file << ": " << strerror(errno);
+    };
+
+    set("cpu.weight", limits.cpu_weight);
+    set("memory.low", limits.memory_low);
+    set("memory.high", limits.memory_high);
+    set("memory.max", limits.memory_max);
+}
+
+std::string Cgroups::cgroup_of(pid_t pid)
+{
+    auto contents = read_file("/proc/" + std::to_string(pid) + "/cgroup");
+    if (!contents)
+        return {};
+
+    // Only the unified hierarchy has id 0, there may be v1 ones besides.
+    size_t start = contents->starts_with("0::") ? 0 : contents->find("\n0::");
+    if (start == std::string::npos)
+        return {};
+    start += contents->starts_with("0::") ? 3 : 4;
+    size_t end = contents->find('\n', start);
+    return contents->substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+std::string Cgroups::path(const std::string& cgroup) const
+{
+    return mount_point + cgroup;
+}
+
+bool Cgroups::init(const CgroupLimits& wm_limits)
+{
+    if (access((std::string(mount_point) + "/cgroup.controllers").c_str(), F_OK) != 0) {
+        LOG(INFO) << "No cgroup v2 hierarchy at " << mount_point << ", spawning without cgroups";
+        return false;
+    }
+
+    std::string own = cgroup_of(getpid());
+    if (own.empty())
+        return false;
+
+    // Restarting doesn't take us out of `wm/`.
+    if (own.ends_with("/wm"))
+        m_root = own.substr(0, own.size() - 3);
+    else
+        m_root = own == "/" ? "" : own;
+
+    std::string root = path(m_root);
+    for (const char* group : { "/wm", "/apps" }) {
+        if (mkdir((root + group).c_str(), 0755) < 0 && errno != EEXIST) {
+            LOG(INFO) << "Can't create cgroups in " << root << " (" << strerror(errno)
+                      << "), spawning without cgroups. See lib/cgroup/LibCgroup.h";
+            return false;
+        }
+    }
+
+    if (!write_file(root + "/wm/cgroup.procs", "0")) {
+        LOG(WARNING) << "Could not move into " << root << "/wm: " << strerror(errno);
+        return false;
+    }
+
+    // Only a group without processes of its own can hand controllers down,
+    // fails if whoever started us is still in there. Usage is still counted
+    // then, only the limits can't be set.
+    for (const char* group : { "", "/apps" }) {
+        if (!write_file(root + group + "/cgroup.subtree_control", "+cpu +memory"))
+            LOG(WARNING) << "Could not enable the cpu and memory controllers below " << root << group << ": "
+                         << strerror(errno);
+    }
+
+    apply_limits(root + "/wm", wm_limits);
+
+    if (DIR* dir = opendir((root + "/apps").c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_type == DT_DIR && entry->d_name[0] != '.')
+                m_scopes[m_root + "/apps/" + entry->d_name];
+        }
+        closedir(dir);
+    }
+
+    LOG(INFO) << "Spawning into cgroups below " << root << "/apps, " << m_scopes.size() << " left from before";
+    m_enabled = true;
+    m_last_update = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool Cgroups::enabled() const
+{
+    return m_enabled;
+}
+
+int Cgroups::open_scope(const char* command, const CgroupLimits& limits)
+{
+    if (!m_enabled)
+        return -1;
+
+    // Named after the program, without its path and arguments.
+    const char* start = command;
+    while (isspace(*start))
+        start++;
+    const char* end = start;
+    while (*end && !isspace(*end))
+        end++;
+    for (const char* c = start; c < end; c++) {
+        if (*c == '/')
+            start = c + 1;
+    }
+
+    std::string name;
+    for (const char* c = start; c < end && name.size() < 32; c++)
+        name += isalnum(*c) || *c == '-' || *c == '_' || *c == '.' ? *c : '_';
+    if (name.empty() || name[0] == '.')
+        name.insert(0, "cmd");
+
+    std::string cgroup;
+    for (;;) {
+        cgroup = m_root + "/apps/" + name + "-" + std::to_string(m_next_id++);
+        if (mkdir(path(cgroup).c_str(), 0755) == 0)
+            break;
+        if (errno != EEXIST) {
+            LOG(WARNING) << "Could not create " << path(cgroup) << ": " << strerror(errno);
+            return -1;
+        }
+    }
+
+    apply_limits(path(cgroup), limits);
+
+    int fd = open((path(cgroup) + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG(WARNING) << "Could not open " << path(cgroup) << "/cgroup.procs: " << strerror(errno);
+        rmdir(path(cgroup).c_str());
+        return -1;
+    }
+
+    m_scopes[cgroup];
+    return fd;
+}
+
+void Cgroups::update()
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed_usec = std::chrono::duration<double, std::micro>(now - m_last_update).count();
+    m_last_update = now;
+
+    for (auto it = m_scopes.begin(); it != m_scopes.end();) {
+        std::string scope_path = path(it->first);
+
+        // Every process in it has exited. Empty doesn't mean that until the
+        // child it was made for has moved in, removing it before then would
+        // leave that child running in `wm/`.
+        Scope& scope = it->second;
+        auto populated = read_key(scope_path + "/cgroup.events", "populated");
+        if (populated && *populated)
+            scope.was_populated = true;
+        bool done = scope.was_populated || now - scope.created > move_in_timeout;
+        if (!populated || (*populated == 0 && done && rmdir(scope_path.c_str()) == 0)) {
+            it = m_scopes.erase(it);
+            continue;
+        }
+
+        uint64_t cpu_usec = read_key(scope_path + "/cpu.stat", "usage_usec").value_or(scope.cpu_usec);
+        if (scope.cpu_usec && elapsed_usec > 0)
+            scope.usage.cpu_percent = 100.0 * (cpu_usec - scope.cpu_usec) / elapsed_usec;
+        scope.cpu_usec = cpu_usec;
+
+        // Without the memory controller there's no memory.current.
+        if (auto memory = read_file(scope_path + "/memory.current"))
+            scope.usage.memory_bytes = strtoull(memory->c_str(), nullptr, 10);
+
+        ++it;
+    }
+}
+
+std::optional<CgroupUsage> Cgroups::usage(const std::string& cgroup) const
+{
+    auto it = m_scopes.find(cgroup);
+    if (it == m_scopes.end())
+        return std::nullopt;
+    return it->second.usage;
+}
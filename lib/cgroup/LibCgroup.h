@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+
+// Limits for a group, zero leaves the kernel's default (no limit, a weight
+// of 100).
+struct CgroupLimits {
+    unsigned int cpu_weight;
+    uint64_t memory_low;
+    uint64_t memory_high;
+    uint64_t memory_max;
+};
+
+struct CgroupUsage {
+    float cpu_percent; // of one CPU, since the previous `update()`
+    uint64_t memory_bytes;
+};
+
+// Gives every spawned command a cgroup (v2) of its own, next to one the
+// window manager moves itself into:
+//
+//   <the group we were started in>/
+//       wm/
+//       apps/
+//           xterm-1/
+//           firefox-2/
+//
+// That only works in a group we're allowed to manage, which a login session
+// normally isn't, so start pluswm in a delegated one, e.g. through
+// `systemd-run --user --scope -p Delegate=yes pluswm`. Anywhere else this
+// stays disabled and everything is spawned like before.
+class Cgroups {
+public:
+    Cgroups() = default;
+    Cgroups(const Cgroups&) = delete;
+    Cgroups operator=(const Cgroups&) = delete;
+
+    ~Cgroups() = default;
+
+    // Moves us into `wm/` with the given limits. After a restart we already
+    // are, and the groups of the previous instance are picked up again.
+    bool init(const CgroupLimits&);
+    bool enabled() const;
+
+    // Creates the group for a command about to be spawned and opens its
+    // `cgroup.procs`, for the child to move itself into before it execs.
+    // -1 if disabled or that failed, the caller closes it otherwise.
+    int open_scope(const char*, const CgroupLimits&);
+
+    // The group of a process as found in /proc, safe to call from any
+    // thread. Empty if it's gone.
+    static std::string cgroup_of(pid_t);
+
+    // Reads the usage of every group and removes those left empty.
+    void update();
+    std::optional<CgroupUsage> usage(const std::string&) const;
+
+private:
+    struct Scope {
+        CgroupUsage usage {};
+        uint64_t cpu_usec { 0 };
+        // The child a group is made for moves itself in after the fork, so
+        // an empty group is only done with once it has had a process in it,
+        // or hasn't got one in a long time (the child died before).
+        bool was_populated { false };
+        std::chrono::steady_clock::time_point created { std::chrono::steady_clock::now() };
+    };
+
+    std::string path(const std::string&) const;
+
+    bool m_enabled { false };
+    // Relative to the cgroup2 mount, in the form /proc reports it.
+    std::string m_root;
+    std::unordered_map<std::string, Scope> m_scopes;
+    unsigned long m_next_id { 1 };
+    std::chrono::steady_clock::time_point m_last_update;
+};
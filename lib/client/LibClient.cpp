@@ -3,24 +3,57 @@
  */
 
 #include <LibClient.h>
+#include <LibConfig.h>
+#include <LibTrace.h>
 #include <LibWM.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <algorithm>
-#include <config.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
 #include <glog/logging.h>
+#include <unistd.h>
 
 Client::Client(Display* dpy, Window window)
     : m_window(window)
     , m_display(dpy)
+    , m_store(&WinMan::get().geometry())
 {
     XWindowAttributes attrs;
     XGetWindowAttributes(m_display, m_window, &attrs);
 
-    m_size.height = attrs.height;
-    m_size.width = attrs.width;
-    m_position.x = attrs.x;
-    m_position.y = attrs.y;
+    m_handle = m_store->add(m_window, { attrs.x, attrs.y }, { attrs.width, attrs.height }, 1, 0);
+    m_visual = attrs.visual;
+    m_depth = attrs.depth;
+    m_is_mapped = attrs.map_state != IsUnmapped;
+}
+
+Client::Client(Display* dpy, Window window, Position<int> position, Size<int> size, Visual* visual, int depth,
+    bool is_mapped)
+    : m_window(window)
+    , m_display(dpy)
+    , m_store(&WinMan::get().geometry())
+    , m_handle(m_store->add(m_window, position, size, 1, 0))
+    , m_visual(visual)
+    , m_depth(depth)
+    , m_is_mapped(is_mapped)
+{
+}
+
+Client::Client(Display* dpy, const ClientState& state)
+    : m_window(state.window)
+    , m_display(dpy)
+    , m_store(&WinMan::get().geometry())
+    , m_is_mapped(true)
+    , m_focus_locked(state.focus_locked)
+{
+    uint8_t flags = (state.is_floating ? GeometryStore::Floating : 0)
+        | (state.is_fullscreen ? GeometryStore::Fullscreen : 0)
+        | (state.is_aot ? GeometryStore::AlwaysOnTop : 0);
+    m_handle = m_store->add(m_window, state.position, state.size, state.tags, flags);
+    m_store->prev_width[m_handle] = state.prev_size.width;
+    m_store->prev_height[m_handle] = state.prev_size.height;
 }
 
 Window Client::window() const
@@ -28,19 +61,29 @@ Window Client::window() const
     return m_window;
 }
 
+Window Client::outer_window() const
+{
+    return m_frame.window != None ? m_frame.window : m_window;
+}
+
+GeometryStore::Handle Client::handle() const
+{
+    return m_handle;
+}
+
 Position<int> Client::position() const
 {
-    return m_position;
+    return { m_store->x[m_handle], m_store->y[m_handle] };
 }
 
 Size<int> Client::size() const
 {
-    return m_size;
+    return { m_store->width[m_handle], m_store->height[m_handle] };
 }
 
 Size<int> Client::prev_size() const
 {
-    return m_prev_size;
+    return { m_store->prev_width[m_handle], m_store->prev_height[m_handle] };
 }
 
 bool Client::focus_lock() const
@@ -55,16 +98,126 @@ bool Client::is_focused() const
 
 bool Client::is_fullscreen() const
 {
-	return m_is_fullscreen;
+	return m_store->has(m_handle, GeometryStore::Fullscreen);
 }
 
 bool Client::is_aot() const
 {
-	return m_is_aot;
+	return m_store->has(m_handle, GeometryStore::AlwaysOnTop);
+}
+
+bool Client::is_floating() const
+{
+    return m_store->has(m_handle, GeometryStore::Floating);
+}
+
+void Client::set_floating(bool floating)
+{
+    m_store->set(m_handle, GeometryStore::Floating, floating);
+}
+
+unsigned int Client::tags() const
+{
+    return m_store->tags[m_handle];
+}
+
+void Client::set_tags(unsigned int tags)
+{
+    m_store->set_tags(m_handle, tags);
+}
+
+pid_t Client::pid() const
+{
+    return m_pid;
+}
+
+void Client::set_pid(pid_t pid)
+{
+    m_pid = pid;
+}
+
+const std::string& Client::title() const
+{
+    return m_title;
+}
+
+void Client::set_title(std::string title)
+{
+    m_title = std::move(title);
+}
+
+bool Client::is_urgent() const
+{
+    return m_urgent;
+}
+
+void Client::set_urgent(bool urgent)
+{
+    m_urgent = urgent;
+}
+
+const SizeHints& Client::size_hints() const
+{
+    return m_store->hints[m_handle];
+}
+
+void Client::set_size_hints(const SizeHints& hints)
+{
+    m_store->hints[m_handle] = hints;
+    m_store->set(m_handle, GeometryStore::Constrained, hints.constrains());
+}
+
+const std::string& Client::cgroup() const
+{
+    return m_cgroup;
+}
+
+void Client::set_cgroup(std::string cgroup)
+{
+    m_cgroup = std::move(cgroup);
+}
+
+bool Client::is_freezable() const
+{
+    return m_freezable;
+}
+
+void Client::set_freezable(bool freezable)
+{
+    m_freezable = freezable;
+}
+
+bool Client::is_frozen() const
+{
+    return m_frozen;
+}
+
+void Client::freeze()
+{
+    if (m_frozen || m_pid <= 1 || m_pid == getpid())
+        return;
+
+    if (::kill(m_pid, SIGSTOP) < 0) {
+        LOG(WARNING) << "Could not stop process " << m_pid << " of window " << m_window << ": " << strerror(errno);
+        return;
+    }
+    m_frozen = true;
+}
+
+void Client::thaw()
+{
+    if (!m_frozen)
+        return;
+
+    if (::kill(m_pid, SIGCONT) < 0)
+        LOG(WARNING) << "Could not resume process " << m_pid << " of window " << m_window << ": " << strerror(errno);
+    m_frozen = false;
 }
 
 void Client::kill()
 {
+    TRACE_SPAN("Client::kill");
+
     Display* dpy = WinMan::get().display();
 
     Atom delete_window = WinMan::get().wm_atom(WMAtom::WMDelete);
@@ -80,40 +233,76 @@ void Client::kill()
         msg.xclient.format = 32;
         msg.xclient.data.l[0] = delete_window;
 
-        CHECK(XSendEvent(dpy, m_window, false, NoEventMask, &msg));
-    } else {
-        LOG(INFO) << "Forcefully killing window " << m_window;
-        XGrabServer(dpy);
-        XKillClient(dpy, m_window);
-        XUngrabServer(dpy);
+        if (XSendEvent(dpy, m_window, false, NoEventMask, &msg))
+            return;
+        LOG(WARNING) << "Could not ask window " << m_window << " to close";
     }
+
+    LOG(INFO) << "Forcefully killing window " << m_window;
+    XGrabServer(dpy);
+    XKillClient(dpy, m_window);
+    XUngrabServer(dpy);
 }
 
 void Client::resize(Size<int> size)
 {
-    m_prev_size.width = m_size.width;
-    m_prev_size.height = m_size.height;
+    TRACE_SPAN("Client::resize");
+
+    m_store->prev_width[m_handle] = m_store->width[m_handle];
+    m_store->prev_height[m_handle] = m_store->height[m_handle];
 
-    m_size.width = size.width;
-    m_size.height = size.height;
+    m_store->width[m_handle] = size.width;
+    m_store->height[m_handle] = size.height;
+    m_store->set(m_handle, GeometryStore::Hidden, false);
 
     Position<int> pos = position();
 
-    XMoveResizeWindow(m_display, m_window, pos.x, pos.y, size.width, size.height);
+    if (is_framed()) {
+        XMoveResizeWindow(m_display, m_frame.window, pos.x, pos.y, size.width, size.height + m_frame_offset);
+        XResizeWindow(m_display, m_window, size.width, size.height);
+    } else {
+        XMoveResizeWindow(m_display, m_window, pos.x, pos.y, size.width, size.height);
+    }
     LOG(INFO) << "Resize window " << m_window << " to " << size;
 }
 
 void Client::move(Position<int> pos)
 {
-    m_position.x = pos.x;
-    m_position.y = pos.y;
+    TRACE_SPAN("Client::move");
 
-    XMoveWindow(m_display, m_window, pos.x, pos.y);
+    m_store->x[m_handle] = pos.x;
+    m_store->y[m_handle] = pos.y;
+    m_store->set(m_handle, GeometryStore::Hidden, false);
+
+    XMoveWindow(m_display, outer_window(), pos.x, pos.y);
     LOG(INFO) << "Move window " << m_window << " to " << pos;
 }
 
+void Client::move_resize(Position<int> pos, Size<int> size)
+{
+    TRACE_SPAN("Client::move_resize");
+
+    m_store->x[m_handle] = pos.x;
+    m_store->y[m_handle] = pos.y;
+    m_store->width[m_handle] = size.width;
+    m_store->height[m_handle] = size.height;
+
+    // Out of sight it stays, `show()` puts it where it now belongs.
+    if (m_store->has(m_handle, GeometryStore::Hidden))
+        return;
+
+    if (is_framed()) {
+        XMoveResizeWindow(m_display, m_frame.window, pos.x, pos.y, size.width, size.height + m_frame_offset);
+        XResizeWindow(m_display, m_window, size.width, size.height);
+    } else {
+        XMoveResizeWindow(m_display, m_window, pos.x, pos.y, size.width, size.height);
+    }
+}
+
 void Client::focus()
 {
+    TRACE_SPAN("Client::focus");
+
     Display* dpy = WinMan::get().display();
 
     XSetInputFocus(dpy, m_window, RevertToPointerRoot, CurrentTime);
@@ -132,16 +321,20 @@ void Client::focus()
         msg.xclient.data.l[0] = take_focus;
         msg.xclient.data.l[1] = CurrentTime;
 
-        CHECK(XSendEvent(dpy, m_window, false, NoEventMask, &msg));
+        if (!XSendEvent(dpy, m_window, false, NoEventMask, &msg))
+            LOG(WARNING) << "Could not send WM_TAKE_FOCUS to window " << m_window;
     }
 
     m_is_focused = true;
+    WinMan::get().focus_changed(m_window);
 
 	LOG(INFO) << "Window " << m_window << " focused";
 }
 
 void Client::unfocus()
 {
+    TRACE_SPAN("Client::unfocus");
+
     XSetInputFocus(WinMan::get().display(), None, RevertToPointerRoot, CurrentTime);
     m_is_focused = false;
 	LOG(INFO) << "Window " << m_window << " unfocused";
@@ -149,17 +342,84 @@ void Client::unfocus()
 
 void Client::map()
 {
+    TRACE_SPAN("Client::map");
+
     XMapWindow(WinMan::get().display(), m_window);
+    if (is_framed())
+        XMapWindow(m_display, m_frame.window);
+    m_is_mapped = true;
 }
 
 void Client::unmap()
 {
-    XUnmapWindow(WinMan::get().display(), m_window);
+    TRACE_SPAN("Client::unmap");
+
+    // A framed window stays mapped inside its frame, otherwise the
+    // UnmapNotify must not be taken for the client withdrawing.
+    if (!is_framed())
+        expect_unmap();
+    XUnmapWindow(WinMan::get().display(), outer_window());
+    m_is_mapped = false;
+}
+
+void Client::hide()
+{
+    TRACE_SPAN("Client::hide");
+
+    if (m_store->has(m_handle, GeometryStore::Hidden))
+        return;
+
+    m_store->set(m_handle, GeometryStore::Hidden, true);
+    XMoveWindow(m_display, outer_window(), -2 * m_store->width[m_handle], m_store->y[m_handle]);
+}
+
+void Client::show()
+{
+    TRACE_SPAN("Client::show");
+
+    if (!m_store->has(m_handle, GeometryStore::Hidden))
+        return;
+
+    m_store->set(m_handle, GeometryStore::Hidden, false);
+    Position<int> pos = position();
+    Size<int> size = this->size();
+    if (is_framed()) {
+        XMoveResizeWindow(m_display, m_frame.window, pos.x, pos.y, size.width, size.height + m_frame_offset);
+        XResizeWindow(m_display, m_window, size.width, size.height);
+    } else {
+        XMoveResizeWindow(m_display, m_window, pos.x, pos.y, size.width, size.height);
+    }
 }
 
 void Client::raise_to_top()
 {
-    XRaiseWindow(WinMan::get().display(), m_window);
+    TRACE_SPAN("Client::raise_to_top");
+
+    m_store->raise(m_handle);
+    XRaiseWindow(WinMan::get().display(), outer_window());
+}
+
+void Client::send_configure_notify()
+{
+    Position<int> pos = position();
+    Size<int> size = this->size();
+    int border = m_store->border[m_handle];
+
+    XConfigureEvent event {};
+    event.type = ConfigureNotify;
+    event.display = m_display;
+    event.event = m_window;
+    event.window = m_window;
+    // In root coordinates, so inside the frame's border and below its title.
+    event.x = is_framed() ? pos.x + border : pos.x;
+    event.y = is_framed() ? pos.y + border + m_frame_offset : pos.y;
+    event.width = size.width;
+    event.height = size.height;
+    event.border_width = is_framed() ? 0 : border;
+    event.above = None;
+    event.override_redirect = False;
+
+    XSendEvent(m_display, m_window, False, StructureNotifyMask, reinterpret_cast<XEvent*>(&event));
 }
 
 void Client::toggle_fullscreen()
@@ -199,23 +459,23 @@ void Client::toggle_fullscreen()
 	 * Please help.
 	 */
 
-    LOG(INFO) << "1 fullscreen: " << m_is_fullscreen;
-	if (m_is_fullscreen == false) {
-		m_is_fullscreen = true;
+    LOG(INFO) << "1 fullscreen: " << is_fullscreen();
+	if (is_fullscreen() == false) {
+		m_store->set(m_handle, GeometryStore::Fullscreen, true);
 		this->move(Position<int>{0, 0});
 		this->resize(WinMan::get().monitor().size);
 		this->raise_to_top();
-	} else if (m_is_fullscreen == true) {
-		m_is_fullscreen = false;
-		this->resize(m_prev_size);
+	} else if (is_fullscreen() == true) {
+		m_store->set(m_handle, GeometryStore::Fullscreen, false);
+		this->resize(prev_size());
 	}
 
     // LOG(INFO) << "[!!!] Window " << m_window << " fullscreen: " << m_is_fullscreen;
-    LOG(INFO) << "2 fullscreen: " << m_is_fullscreen;
+    LOG(INFO) << "2 fullscreen: " << is_fullscreen();
 }
 
 void Client::aot(bool val) {
-	m_is_aot = val;
+	m_store->set(m_handle, GeometryStore::AlwaysOnTop, val);
 }
 
 void Client::select_input(long mask = NoEventMask)
@@ -238,7 +498,13 @@ bool Client::find_atom(Atom atom)
 
     Atom* supported_proto;
     int supported_proto_count;
-    CHECK(XGetWMProtocols(dpy, this->window(), &supported_proto, &supported_proto_count));
+    {
+        TRACE_SPAN("XGetWMProtocols");
+        // Fails for a window without WM_PROTOCOLS, and for one that's gone
+        // already, which `on_x_error()` deals with.
+        if (!XGetWMProtocols(dpy, this->window(), &supported_proto, &supported_proto_count))
+            return false;
+    }
 
     bool search_result = std::find(supported_proto, supported_proto + supported_proto_count, atom) != supported_proto + supported_proto_count;
 
@@ -249,15 +515,17 @@ bool Client::find_atom(Atom atom)
 
 void Client::grab_input()
 {
+    TRACE_SPAN("Client::grab_input");
+
 	WinMan& wm = WinMan::get();
 	Display* dpy = wm.display();
 
 	XUngrabButton(dpy, AnyButton, AnyModifier, this->window());
 
-    for (unsigned int i = 0; i < Config::buttons.size(); i++) {
+    for (const auto& button : wm.settings().buttons) {
 		XGrabButton(m_display,
-					Config::buttons[i].button(),
-					Config::modkey,
+					button.button(),
+					button.modmask(),
 					this->window(),
 					false,
 					ButtonPressMask | ButtonReleaseMask | ButtonMotionMask,
@@ -267,3 +535,81 @@ void Client::grab_input()
 					wm.cursor(Cursors::Fleur));
     }
 }
+
+ClientState Client::state() const
+{
+    return { m_window, position(), size(), prev_size(), tags(), is_fullscreen(), is_aot(), m_focus_locked, is_floating() };
+}
+
+Visual* Client::visual() const
+{
+    return m_visual;
+}
+
+int Client::depth() const
+{
+    return m_depth;
+}
+
+bool Client::is_framed() const
+{
+    return m_frame.window != None;
+}
+
+const Frame& Client::frame() const
+{
+    return m_frame;
+}
+
+void Client::reparent_into(const Frame& frame, int offset)
+{
+    TRACE_SPAN("Client::reparent_into");
+
+    m_frame = frame;
+    m_frame_offset = offset;
+
+    Position<int> pos = position();
+    Size<int> size = this->size();
+    XMoveResizeWindow(m_display, m_frame.window, pos.x, pos.y, size.width, size.height + offset);
+
+    // Keeps the window alive and visible if we go away without unframing it.
+    XAddToSaveSet(m_display, m_window);
+
+    if (m_is_mapped)
+        expect_unmap();
+    XReparentWindow(m_display, m_window, m_frame.window, 0, offset);
+
+    if (m_is_mapped)
+        XMapWindow(m_display, m_frame.window);
+}
+
+Frame Client::unparent()
+{
+    TRACE_SPAN("Client::unparent");
+
+    Frame frame = m_frame;
+
+    if (m_is_mapped)
+        expect_unmap();
+    XReparentWindow(m_display, m_window, WinMan::get().root_window(), position().x, position().y + m_frame_offset);
+    XRemoveFromSaveSet(m_display, m_window);
+
+    m_frame = Frame {};
+    m_frame_offset = 0;
+
+    return frame;
+}
+
+void Client::expect_unmap()
+{
+    m_expected_unmaps++;
+}
+
+bool Client::consume_expected_unmap()
+{
+    if (!m_expected_unmaps)
+        return false;
+
+    m_expected_unmaps--;
+    return true;
+}
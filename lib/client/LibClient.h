@@ -4,15 +4,45 @@
 
 #pragma once
 
+#include <LibFrame.h>
+#include <LibGeometry.h>
 #include <LibUtil.h>
 #include <X11/Xlib.h>
+#include <string>
+#include <sys/types.h>
 
 using Util::Position;
 using Util::Size;
 
+// The part of a client that has to survive a restart of the window manager.
+struct ClientState {
+    Window window;
+    Position<int> position;
+    Size<int> size;
+    Size<int> prev_size;
+    unsigned int tags;
+    bool is_fullscreen;
+    bool is_aot;
+    bool focus_locked;
+    bool is_floating;
+};
+
 class Client {
 public:
+    // Properties a copy is kept of, refetched when they change.
+    enum Property : uint8_t {
+        TitleProperty = 1 << 0,       // WM_NAME and _NET_WM_NAME
+        HintsProperty = 1 << 1,       // WM_HINTS, for urgency
+        NormalHintsProperty = 1 << 2, // WM_NORMAL_HINTS
+        ProcessProperty = 1 << 3,     // _NET_WM_PID and WM_CLIENT_MACHINE, only read on manage
+        AllProperties = TitleProperty | HintsProperty | NormalHintsProperty | ProcessProperty
+    };
+
     Client(Display*, Window);
+    // For when the attributes were already fetched.
+    Client(Display*, Window, Position<int>, Size<int>, Visual*, int, bool);
+    // Re-adopts a window from a previous instance, no round trip involved.
+    Client(Display*, const ClientState&);
     Client() = default;
 
     bool operator==(const Client& rhs) const { return this->window() == rhs.window(); }
@@ -21,6 +51,14 @@ public:
 
     Window window() const;
 
+    // The frame if the client has one, the client window itself otherwise.
+    // This is what gets moved, stacked and (un)mapped.
+    Window outer_window() const;
+
+    // The client's slot in `WinMan::geometry()`. Copies of a client share
+    // it, it's freed when the client is unmanaged.
+    GeometryStore::Handle handle() const;
+
     Position<int> position() const;
     Size<int> size() const;
     Size<int> prev_size() const;
@@ -33,10 +71,19 @@ public:
 
 	bool is_aot() const;
 
+    bool is_floating() const;
+    void set_floating(bool);
+
+    unsigned int tags() const;
+    void set_tags(unsigned int);
+
     void kill();
 
     void resize(Size<int>);
     void move(Position<int>);
+    // A single request for both, and the size isn't remembered as the one
+    // to go back to (that's for layouts).
+    void move_resize(Position<int>, Size<int>);
 
     void focus();
     void unfocus();
@@ -44,8 +91,17 @@ public:
     void map();
     void unmap();
 
+    // Moves the window out of sight without unmapping it (which would look
+    // like the client withdrawing it), and back to where it was.
+    void hide();
+    void show();
+
     void raise_to_top();
 
+    // Tells the client where its window is without changing anything, the
+    // answer ICCCM asks for to a ConfigureRequest that isn't granted.
+    void send_configure_notify();
+
     void toggle_fullscreen();
 
 	void aot(bool);
@@ -58,21 +114,77 @@ public:
 
 	void grab_input();
 
+    ClientState state() const;
+
+    // From _NET_WM_PID, fetched in the background after the window is
+    // managed. -1 until then, or if the client doesn't set it.
+    pid_t pid() const;
+    void set_pid(pid_t);
+
+    const std::string& title() const;
+    void set_title(std::string);
+    bool is_urgent() const;
+    void set_urgent(bool);
+    // Kept in `WinMan::geometry()`, where the layout pass reads them.
+    const SizeHints& size_hints() const;
+    void set_size_hints(const SizeHints&);
+
+    // The cgroup the process was spawned into, fetched along with the pid.
+    // Empty unless it's one of ours.
+    const std::string& cgroup() const;
+    void set_cgroup(std::string);
+
+    // Whether a rule allows stopping the process while the client is hidden,
+    // and whether it's stopped right now.
+    bool is_freezable() const;
+    void set_freezable(bool);
+    bool is_frozen() const;
+    void freeze();
+    void thaw();
+
+    Visual* visual() const;
+    int depth() const;
+
+    bool is_framed() const;
+    const Frame& frame() const;
+
+    // Reparents the window into the frame, below a title area of the given
+    // height.
+    void reparent_into(const Frame&, int);
+    // Moves the window back to the root and hands the frame back.
+    Frame unparent();
+
+    // Unmaps we cause ourselves (e.g. by reparenting) must not be mistaken
+    // for the client withdrawing its window.
+    void expect_unmap();
+    bool consume_expected_unmap();
+
 private:
     Window m_window = 0;
     Display* m_display;
 
-    Position<int> m_position = {0, 0};
-    Size<int> m_size = {0,0};
-    Size<int> m_prev_size = {0,0};
+    GeometryStore* m_store { nullptr };
+    GeometryStore::Handle m_handle { GeometryStore::invalid };
+
+    pid_t m_pid { -1 };
+    std::string m_cgroup;
+
+    std::string m_title;
+    bool m_urgent { false };
+    bool m_freezable { false };
+    bool m_frozen { false };
+
+    Visual* m_visual { nullptr };
+    int m_depth { 0 };
+
+    Frame m_frame;
+    int m_frame_offset { 0 };
+    unsigned int m_expected_unmaps { 0 };
 
-    // bool m_is_floating;
-    bool m_is_fullscreen { false };
     // bool m_is_terminal { false };
     // bool m_is_sticky { false };
     bool m_is_focused { false };
     bool m_is_mapped { false };
-	bool m_is_aot { false };
 
     bool m_focus_locked { false };
 };
@@ -0,0 +1,661 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibConfig.h>
+#include <X11/Xlib.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <iterator>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <config.h>
+
+/*
+ * Config file syntax, one statement per line, `#` starts a comment line:
+ *
+ *   border_width 5
+ *   snap_distance 32
+ *   gaps 15 15 15 15
+ *   smart_gaps true
+ *   master_size 0.55
+ *   color border_active "#689d6a"
+ *   bind Mod+Shift+Return spawn "xterm"
+ *   bind Mod+q kill_client
+ *   button Mod+1 move
+ *   bind Mod+2 tag_view 2
+ *   bind Mod+grave toggle_scratchpad term
+ *   bind Mod+x,f toggle_float
+ *   bind Mod+space cycle_layout 1
+ *   bind Mod+Tab stack_focus 1
+ *   bind Mod+Shift+j stack_push 1
+ *   bind Mod+o toggle_overview
+ *   rule class="Gimp" floating=true tag=4
+ *   rule class="firefox" freeze=true
+ *   rule title="YouTube" freeze=false
+ *
+ * `Mod` stands for `Config::modkey`, tags are numbered from 1, keys separated by
+ * commas make a chord (press them one after the other, `comma` is the key).
+ * Scalars and colors override the compiled in defaults one by one; if the file
+ * contains any `bind`, `button` or `rule` statement, that whole list replaces
+ * the compiled in one.
+ */
+
+namespace {
+
+// Read-only private mapping of a file, unmapped on scope exit.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            m_opened = true;
+            if (st.st_size > 0) {
+                void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED) {
+                    m_data = static_cast<const char*>(addr);
+                    m_size = st.st_size;
+                } else {
+                    m_opened = false;
+                }
+            }
+        }
+
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (m_data)
+            munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    bool is_open() const { return m_opened; }
+    std::string_view contents() const { return { m_data, m_size }; }
+
+private:
+    const char* m_data { nullptr };
+    size_t m_size { 0 };
+    bool m_opened { false };
+};
+
+struct Name {
+    const char* name;
+    unsigned int value;
+};
+
+constexpr Name modifier_names[] = {
+    { "Shift", ShiftMask },
+    { "Control", ControlMask },
+    { "Ctrl", ControlMask },
+    { "Lock", LockMask },
+    { "Mod1", Mod1Mask },
+    { "Alt", Mod1Mask },
+    { "Mod2", Mod2Mask },
+    { "Mod3", Mod3Mask },
+    { "Mod4", Mod4Mask },
+    { "Super", Mod4Mask },
+    { "Mod5", Mod5Mask },
+    { "Mod", static_cast<unsigned int>(Config::modkey) },
+};
+
+constexpr Name action_names[] = {
+    { "spawn", static_cast<unsigned int>(KeyAction::Spawn) },
+    { "kill_client", static_cast<unsigned int>(KeyAction::KillClient) },
+    { "stack_focus", static_cast<unsigned int>(KeyAction::StackFocus) },
+    { "stack_push", static_cast<unsigned int>(KeyAction::StackPush) },
+    { "tag_view", static_cast<unsigned int>(KeyAction::TagView) },
+    { "tag_toggle", static_cast<unsigned int>(KeyAction::TagToggle) },
+    { "tag_move_to", static_cast<unsigned int>(KeyAction::TagMoveTo) },
+    { "make_master", static_cast<unsigned int>(KeyAction::MakeMaster) },
+    { "toggle_float", static_cast<unsigned int>(KeyAction::ToggleFloat) },
+    { "toggle_aot", static_cast<unsigned int>(KeyAction::ToggleAOT) },
+    { "toggle_sticky", static_cast<unsigned int>(KeyAction::ToggleSticky) },
+    { "toggle_fullscreen", static_cast<unsigned int>(KeyAction::ToggleFullscreen) },
+    { "inc_master_size", static_cast<unsigned int>(KeyAction::IncMasterSize) },
+    { "dec_master_size", static_cast<unsigned int>(KeyAction::DecMasterSize) },
+    { "inc_master_count", static_cast<unsigned int>(KeyAction::IncMasterCount) },
+    { "dec_master_count", static_cast<unsigned int>(KeyAction::DecMasterCount) },
+    { "restart", static_cast<unsigned int>(KeyAction::Restart) },
+    { "toggle_scratchpad", static_cast<unsigned int>(KeyAction::ToggleScratchpad) },
+    { "cycle_layout", static_cast<unsigned int>(KeyAction::CycleLayout) },
+    { "toggle_overview", static_cast<unsigned int>(KeyAction::ToggleOverview) },
+};
+
+constexpr Name button_action_names[] = {
+    { "resize", static_cast<unsigned int>(ButtonAction::Resize) },
+    { "move", static_cast<unsigned int>(ButtonAction::Move) },
+};
+
+constexpr Name color_names[] = {
+    { "border_active", static_cast<unsigned int>(Colors::WindowBorderActive) },
+    { "border_inactive", static_cast<unsigned int>(Colors::WindowBorderInactive) },
+    { "bar_foreground", static_cast<unsigned int>(Colors::BarForeground) },
+    { "bar_background", static_cast<unsigned int>(Colors::BarBackground) },
+    { "bar_selected_foreground", static_cast<unsigned int>(Colors::BarSelectedForeground) },
+    { "bar_selected_background", static_cast<unsigned int>(Colors::BarSelectedBackground) },
+};
+
+template<size_t N>
+bool lookup(const Name (&table)[N], std::string_view name, unsigned int& out)
+{
+    for (const auto& entry : table) {
+        if (name == entry.name) {
+            out = entry.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Splits a line into whitespace separated tokens. Double quoted tokens may
+// contain whitespace; the quotes are not part of the token. No copies are made,
+// every token points into the mapped file.
+std::vector<std::string_view> tokenize(std::string_view line)
+{
+    std::vector<std::string_view> tokens;
+    size_t i = 0;
+
+    while (i < line.size()) {
+        while (i < line.size() && isspace(static_cast<unsigned char>(line[i])))
+            i++;
+        if (i >= line.size())
+            break;
+
+        size_t start = i;
+        bool quoted = false;
+        while (i < line.size() && (quoted || !isspace(static_cast<unsigned char>(line[i])))) {
+            if (line[i] == '"')
+                quoted = !quoted;
+            i++;
+        }
+
+        std::string_view token = line.substr(start, i - start);
+        if (token.size() >= 2 && token.front() == '"' && token.back() == '"')
+            token = token.substr(1, token.size() - 2);
+        tokens.push_back(token);
+    }
+
+    return tokens;
+}
+
+template<typename T>
+bool parse_number(std::string_view token, T& out)
+{
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), out);
+    return ec == std::errc() && ptr == token.data() + token.size();
+}
+
+bool parse_float(std::string_view token, float& out)
+{
+    // std::from_chars for floating point needs a newer libstdc++ than the one
+    // we build against in CI.
+    std::string copy(token);
+    char* end;
+    errno = 0;
+    out = strtof(copy.c_str(), &end);
+    return errno == 0 && end == copy.c_str() + copy.size();
+}
+
+// Tags are numbered from 1 in the config file, and used as bitmasks internally.
+bool parse_tag(std::string_view token, unsigned int& out)
+{
+    unsigned int tag;
+    if (!parse_number(token, tag) || tag < 1 || tag > Config::tags.size())
+        return false;
+    out = 1 << (tag - 1);
+    return true;
+}
+
+bool parse_bool(std::string_view token, bool& out)
+{
+    if (token == "true" || token == "yes" || token == "1")
+        out = true;
+    else if (token == "false" || token == "no" || token == "0")
+        out = false;
+    else
+        return false;
+    return true;
+}
+
+// Parses "Mod+Shift+x" style combos; everything but the last part has to be a
+// modifier name.
+bool parse_combo(std::string_view token, unsigned int& modmask, std::string_view& key)
+{
+    modmask = 0;
+
+    size_t plus;
+    while ((plus = token.find('+')) != std::string_view::npos && plus + 1 < token.size()) {
+        unsigned int mod;
+        if (!lookup(modifier_names, token.substr(0, plus), mod))
+            return false;
+        modmask |= mod;
+        token.remove_prefix(plus + 1);
+    }
+
+    key = token;
+    return !key.empty();
+}
+
+}
+
+std::unique_ptr<Settings> Settings::defaults()
+{
+    std::unique_ptr<Settings> settings(new Settings);
+
+    settings->border_width_in_px = Config::border_width_in_px;
+    settings->snap_distance_in_px = Config::snap_distance_in_px;
+    settings->gaps = Config::gaps;
+    settings->smart_gaps = Config::smart_gaps;
+    settings->master_size = Config::master_size;
+    settings->keybinds = Config::keybinds;
+    settings->buttons = Config::buttons;
+    settings->rules = Config::rules;
+
+    for (const auto& [color, value] : Config::colors)
+        settings->colors[color] = value;
+
+    return settings;
+}
+
+std::unique_ptr<Settings> Settings::load(const std::string& path)
+{
+    MappedFile file(path);
+    if (!file.is_open()) {
+        LOG(INFO) << "No config file at " << path << ": " << strerror(errno);
+        return nullptr;
+    }
+
+    std::unique_ptr<Settings> settings = defaults();
+    settings->parse(file.contents(), path);
+
+    LOG(INFO) << "Loaded config file " << path;
+    return settings;
+}
+
+std::string Settings::default_path()
+{
+    if (const char* xdg = getenv("XDG_CONFIG_HOME"); xdg && *xdg)
+        return std::string(xdg) + "/pluswm/pluswmrc";
+    if (const char* home = getenv("HOME"); home && *home)
+        return std::string(home) + "/.config/pluswm/pluswmrc";
+    return {};
+}
+
+const char* Settings::intern(std::string_view str)
+{
+    return m_strings.emplace_back(str).c_str();
+}
+
+void Settings::parse(std::string_view contents, const std::string& path)
+{
+    unsigned int line_number = 0;
+
+    while (!contents.empty()) {
+        line_number++;
+
+        size_t eol = contents.find('\n');
+        std::string_view line = contents.substr(0, eol);
+        contents.remove_prefix(eol == std::string_view::npos ? contents.size() : eol + 1);
+
+        auto tokens = tokenize(line);
+        if (tokens.empty() || (!tokens[0].empty() && tokens[0].front() == '#'))
+            continue;
+
+        if (!parse_line(tokens))
+            LOG(WARNING) << path << ":" << line_number << ": ignoring invalid statement `" << line << "`";
+    }
+}
+
+bool Settings::parse_line(const std::vector<std::string_view>& tokens)
+{
+    std::string_view keyword = tokens[0];
+    size_t argc = tokens.size() - 1;
+
+    if (keyword == "border_width" && argc == 1)
+        return parse_number(tokens[1], border_width_in_px);
+
+    if (keyword == "snap_distance" && argc == 1)
+        return parse_number(tokens[1], snap_distance_in_px);
+
+    if (keyword == "smart_gaps" && argc == 1)
+        return parse_bool(tokens[1], smart_gaps);
+
+    if (keyword == "master_size" && argc == 1) {
+        float size;
+        if (!parse_float(tokens[1], size) || size <= 0.0f || size >= 1.0f)
+            return false;
+        master_size = size;
+        return true;
+    }
+
+    if (keyword == "gaps" && argc == 4) {
+        unsigned int g[4];
+        for (size_t i = 0; i < 4; i++) {
+            if (!parse_number(tokens[i + 1], g[i]))
+                return false;
+        }
+        gaps = Gaps(g[0], g[1], g[2], g[3]);
+        return true;
+    }
+
+    if (keyword == "color" && argc == 2) {
+        unsigned int color;
+        if (!lookup(color_names, tokens[1], color))
+            return false;
+        colors[static_cast<Colors>(color)] = tokens[2];
+        return true;
+    }
+
+    if (keyword == "bind" && (argc == 2 || argc == 3)) {
+        unsigned int action;
+        if (!lookup(action_names, tokens[2], action))
+            return false;
+
+        std::vector<KeyStroke> strokes;
+        std::string_view keys = tokens[1];
+        while (!keys.empty()) {
+            size_t comma = keys.find(',');
+            unsigned int modmask;
+            std::string_view key;
+            if (!parse_combo(keys.substr(0, comma), modmask, key))
+                return false;
+
+            KeySym keysym = XStringToKeysym(std::string(key).c_str());
+            if (keysym == NoSymbol)
+                return false;
+            strokes.push_back({ modmask, keysym });
+
+            if (comma == std::string_view::npos)
+                break;
+            keys.remove_prefix(comma + 1);
+        }
+        if (strokes.empty())
+            return false;
+
+        Arg arg { .v = nullptr };
+        switch (static_cast<KeyAction>(action)) {
+        case KeyAction::Spawn:
+        case KeyAction::ToggleScratchpad:
+            if (argc != 3)
+                return false;
+            arg.s = intern(tokens[3]);
+            break;
+        case KeyAction::TagView:
+        case KeyAction::TagToggle:
+        case KeyAction::TagMoveTo:
+            if (argc != 3 || !parse_tag(tokens[3], arg.ui))
+                return false;
+            break;
+        case KeyAction::IncMasterSize:
+        case KeyAction::DecMasterSize:
+            if (argc != 3 || !parse_float(tokens[3], arg.f))
+                return false;
+            break;
+        case KeyAction::StackFocus:
+        case KeyAction::StackPush:
+        case KeyAction::IncMasterCount:
+        case KeyAction::DecMasterCount:
+        case KeyAction::CycleLayout:
+            if (argc != 3 || !parse_number(tokens[3], arg.i))
+                return false;
+            break;
+        default:
+            if (argc != 2)
+                return false;
+            break;
+        }
+
+        if (!m_has_keybinds) {
+            keybinds.clear();
+            m_has_keybinds = true;
+        }
+        KeyStroke first = strokes.front();
+        strokes.erase(strokes.begin());
+        keybinds.emplace_back(first.modmask, first.keysym, std::move(strokes), static_cast<KeyAction>(action), arg);
+        return true;
+    }
+
+    if (keyword == "button" && argc == 2) {
+        unsigned int modmask;
+        std::string_view key;
+        unsigned int button;
+        unsigned int action;
+        if (!parse_combo(tokens[1], modmask, key) || !lookup(button_action_names, tokens[2], action))
+            return false;
+        if (!parse_number(key, button) || button < Button1 || button > Button5)
+            return false;
+
+        if (!m_has_buttons) {
+            buttons.clear();
+            m_has_buttons = true;
+        }
+        buttons.emplace_back(modmask, button, static_cast<ButtonAction>(action));
+        return true;
+    }
+
+    if (keyword == "rule" && argc >= 1) {
+        Rule rule {};
+
+        for (size_t i = 1; i < tokens.size(); i++) {
+            size_t eq = tokens[i].find('=');
+            if (eq == std::string_view::npos)
+                return false;
+
+            std::string_view key = tokens[i].substr(0, eq);
+            std::string_view value = tokens[i].substr(eq + 1);
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+                value = value.substr(1, value.size() - 2);
+
+            bool ok = true;
+            if (key == "class")
+                rule.win_class = intern(value);
+            else if (key == "instance")
+                rule.win_instance = intern(value);
+            else if (key == "title")
+                rule.win_title = intern(value);
+            else if (key == "tag")
+                ok = parse_tag(value, rule.tag);
+            else if (key == "floating")
+                ok = parse_bool(value, rule.is_floating);
+            else if (key == "terminal")
+                ok = parse_bool(value, rule.is_terminal);
+            else if (key == "noswallow")
+                ok = parse_bool(value, rule.no_swallow);
+            else if (key == "monitor")
+                ok = parse_bool(value, rule.monitor);
+            else if (key == "freeze") {
+                bool freeze;
+                ok = parse_bool(value, freeze);
+                rule.freeze = freeze ? FreezePolicy::Freeze : FreezePolicy::Exempt;
+            }
+            else
+                ok = false;
+
+            if (!ok)
+                return false;
+        }
+
+        if (!m_has_rules) {
+            rules.clear();
+            m_has_rules = true;
+        }
+        rules.push_back(rule);
+        return true;
+    }
+
+    return false;
+}
+
+SettingsDiff SettingsDiff::between(const Settings& old, const Settings& now)
+{
+    SettingsDiff diff;
+
+    auto grabs_of = [](const Settings& s) {
+        std::vector<Grab> grabs;
+        for (const auto& keybind : s.keybinds)
+            grabs.emplace_back(keybind.modmask(), keybind.keysym());
+        std::sort(grabs.begin(), grabs.end());
+        grabs.erase(std::unique(grabs.begin(), grabs.end()), grabs.end());
+        return grabs;
+    };
+
+    auto old_grabs = grabs_of(old);
+    auto new_grabs = grabs_of(now);
+    std::set_difference(old_grabs.begin(), old_grabs.end(), new_grabs.begin(), new_grabs.end(),
+        std::back_inserter(diff.grabs_removed));
+    std::set_difference(new_grabs.begin(), new_grabs.end(), old_grabs.begin(), old_grabs.end(),
+        std::back_inserter(diff.grabs_added));
+
+    diff.buttons_changed = !std::equal(old.buttons.begin(), old.buttons.end(), now.buttons.begin(), now.buttons.end(),
+        [](const Button& a, const Button& b) {
+            return a.modmask() == b.modmask() && a.button() == b.button() && a.action() == b.action();
+        });
+
+    diff.colors_changed = old.colors != now.colors;
+    diff.border_width_changed = old.border_width_in_px != now.border_width_in_px;
+
+    diff.layout_changed = old.gaps.in_h != now.gaps.in_h
+        || old.gaps.in_v != now.gaps.in_v
+        || old.gaps.out_h != now.gaps.out_h
+        || old.gaps.out_v != now.gaps.out_v
+        || old.smart_gaps != now.smart_gaps
+        || old.master_size != now.master_size;
+
+    return diff;
+}
+
+bool SettingsDiff::empty() const
+{
+    return grabs_removed.empty() && grabs_added.empty() && !buttons_changed && !colors_changed
+        && !border_width_changed && !layout_changed;
+}
+
+ConfigWatcher::ConfigWatcher(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    if (path.empty() || slash == std::string::npos)
+        return;
+
+    m_dir = slash ? path.substr(0, slash) : "/";
+    m_file_name = path.substr(slash + 1);
+
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        LOG(WARNING) << "inotify_init1() failed, config hot reload disabled: " << strerror(errno);
+        return;
+    }
+
+    if (!watch_closest()) {
+        LOG(INFO) << "Not watching " << m_dir << " for config changes: " << strerror(errno);
+        close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    if (m_watched != m_dir)
+        LOG(INFO) << m_dir << " doesn't exist (yet), watching " << m_watched << " for it to appear";
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+int ConfigWatcher::fd() const
+{
+    return m_fd;
+}
+
+bool ConfigWatcher::watch_closest()
+{
+    std::string dir = m_dir;
+    for (;;) {
+        uint32_t mask = dir == m_dir ? IN_CLOSE_WRITE | IN_MOVED_TO : IN_CREATE | IN_MOVED_TO;
+        int watch = inotify_add_watch(m_fd, dir.c_str(), mask | IN_DELETE_SELF | IN_MOVE_SELF);
+        if (watch >= 0) {
+            if (m_watch >= 0 && m_watch != watch)
+                inotify_rm_watch(m_fd, m_watch);
+            m_watch = watch;
+            m_watched = dir;
+            return true;
+        }
+
+        if ((errno != ENOENT && errno != ENOTDIR) || dir == "/")
+            return false;
+        size_t slash = dir.rfind('/');
+        if (slash == std::string::npos)
+            return false;
+        dir = slash ? dir.substr(0, slash) : "/";
+    }
+}
+
+bool ConfigWatcher::consume_events()
+{
+    alignas(inotify_event) char buffer[4096];
+    bool changed = false;
+    bool moved = false;
+    bool dropped = false;
+
+    for (;;) {
+        ssize_t len = read(m_fd, buffer, sizeof(buffer));
+        if (len <= 0)
+            break;
+
+        for (char* ptr = buffer; ptr < buffer + len;) {
+            auto* event = reinterpret_cast<inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+            if (event->wd != m_watch)
+                continue;
+
+            // The watched directory went away, or a directory appeared on
+            // the way down to the config's.
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                moved = true;
+            // Only a removed directory takes its watch with it, a moved one
+            // keeps it.
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+                dropped = true;
+            else if (m_watched != m_dir)
+                moved |= (event->mask & IN_ISDIR) != 0;
+            else if (event->len && m_file_name == event->name)
+                changed = true;
+        }
+    }
+
+    if (moved) {
+        // Otherwise `watch_closest()` removes it once there's a new one.
+        if (dropped)
+            m_watch = -1;
+        if (!watch_closest()) {
+            if (m_watch >= 0)
+                inotify_rm_watch(m_fd, m_watch);
+            m_watch = -1;
+            LOG(WARNING) << "Lost the watch on " << m_dir << ", config hot reload disabled: " << strerror(errno);
+            return changed;
+        }
+        LOG(INFO) << "Watching " << m_watched << " for config changes";
+        // The file may have been written before the watch was in place.
+        if (m_watched == m_dir && access((m_dir + "/" + m_file_name).c_str(), F_OK) == 0)
+            changed = true;
+    }
+
+    return changed;
+}
@@ -0,0 +1,114 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <LibButton.h>
+#include <LibKeybind.h>
+#include <LibWM.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The settings the window manager is actually running with. They start out as
+// the compiled-in values from `src/config.h` and can be overridden by an
+// optional runtime config file (see `Settings::default_path()`).
+class Settings {
+public:
+    Settings(const Settings&) = delete;
+    Settings operator=(const Settings&) = delete;
+
+    ~Settings() = default;
+
+    // The values compiled in from `src/config.h`.
+    static std::unique_ptr<Settings> defaults();
+
+    // Parses the config file at `path` on top of the compiled-in defaults.
+    // Returns nullptr if the file can't be opened. Malformed lines are logged
+    // and skipped.
+    static std::unique_ptr<Settings> load(const std::string& path);
+
+    // $XDG_CONFIG_HOME/pluswm/pluswmrc, falling back to ~/.config.
+    static std::string default_path();
+
+    unsigned int border_width_in_px;
+    unsigned int snap_distance_in_px;
+
+    Gaps gaps { 0, 0, 0, 0 };
+    bool smart_gaps;
+
+    float master_size;
+
+    std::vector<Keybind> keybinds;
+    std::vector<Button> buttons;
+    std::map<Colors, std::string> colors;
+    std::vector<Rule> rules;
+
+private:
+    Settings() = default;
+
+    void parse(std::string_view, const std::string&);
+    bool parse_line(const std::vector<std::string_view>&);
+
+    // Keybind arguments and rule matchers are plain `const char*`, so any
+    // string that has to outlive the parsed buffer is copied in here.
+    const char* intern(std::string_view);
+
+    std::deque<std::string> m_strings;
+
+    bool m_has_keybinds { false };
+    bool m_has_buttons { false };
+    bool m_has_rules { false };
+};
+
+// What has to be re-applied to go from one set of settings to another.
+struct SettingsDiff {
+    using Grab = std::pair<unsigned int, KeySym>;
+
+    std::vector<Grab> grabs_removed;
+    std::vector<Grab> grabs_added;
+
+    bool buttons_changed { false };
+    bool colors_changed { false };
+    bool border_width_changed { false };
+    bool layout_changed { false };
+
+    static SettingsDiff between(const Settings&, const Settings&);
+
+    bool empty() const;
+};
+
+// Watches the directory containing the config file through inotify, so editors
+// that replace the file instead of writing it in place are picked up too. If
+// the directory doesn't exist, the closest ancestor that does is watched until
+// it's created.
+class ConfigWatcher {
+public:
+    explicit ConfigWatcher(const std::string&);
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher operator=(const ConfigWatcher&) = delete;
+
+    ~ConfigWatcher();
+
+    // -1 if the watch could not be set up.
+    int fd() const;
+
+    // Drains all pending inotify events and returns whether any of them
+    // touched the config file.
+    bool consume_events();
+
+private:
+    // Watches the config's directory, or the closest existing ancestor.
+    bool watch_closest();
+
+    int m_fd { -1 };
+    int m_watch { -1 };
+    std::string m_dir;
+    std::string m_watched;
+    std::string m_file_name;
+};
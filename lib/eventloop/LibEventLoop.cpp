@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibEventLoop.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <glog/logging.h>
+
+void EventLoop::watch_fd(int fd, Callback callback)
+{
+    CHECK_GE(fd, 0);
+    unwatch_fd(fd);
+    m_watches.push_back({ fd, std::move(callback) });
+}
+
+void EventLoop::unwatch_fd(int fd)
+{
+    std::erase_if(m_watches, [fd](const Watch& w) { return w.fd == fd; });
+}
+
+EventLoop::TimerId EventLoop::add_timer(std::chrono::milliseconds delay, Callback callback)
+{
+    TimerId id = m_next_timer_id++;
+    m_timers.emplace(Clock::now() + delay, Timer { id, std::move(callback) });
+    return id;
+}
+
+void EventLoop::cancel_timer(TimerId id)
+{
+    std::erase_if(m_timers, [id](const auto& entry) { return entry.second.id == id; });
+}
+
+void EventLoop::run_expired_timers()
+{
+    auto now = Clock::now();
+
+    // Timers added by the callbacks below only run on the next iteration.
+    std::vector<Callback> expired;
+    while (!m_timers.empty() && m_timers.begin()->first <= now) {
+        expired.push_back(std::move(m_timers.begin()->second.callback));
+        m_timers.erase(m_timers.begin());
+    }
+
+    for (auto& callback : expired)
+        callback();
+}
+
+void EventLoop::run_once(int timeout)
+{
+    if (!m_timers.empty()) {
+        auto until_next = std::chrono::ceil<std::chrono::milliseconds>(m_timers.begin()->first - Clock::now());
+        int next = std::max<int>(0, until_next.count());
+        timeout = timeout < 0 ? next : std::min(timeout, next);
+    }
+
+    m_pollfds.clear();
+    for (const auto& watch : m_watches)
+        m_pollfds.push_back({ watch.fd, POLLIN, 0 });
+
+    int ready = poll(m_pollfds.data(), m_pollfds.size(), timeout);
+    if (ready < 0) {
+        if (errno != EINTR)
+            LOG(ERROR) << "poll() failed: " << strerror(errno) << " (errno=" << errno << ")";
+        run_expired_timers();
+        return;
+    }
+
+    // Callbacks may (un)watch fds, so collect the ready ones before running any.
+    std::vector<int> ready_fds;
+    for (const auto& pfd : m_pollfds) {
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+            ready_fds.push_back(pfd.fd);
+    }
+
+    for (int fd : ready_fds) {
+        auto it = std::find_if(m_watches.begin(), m_watches.end(), [fd](const Watch& w) { return w.fd == fd; });
+        if (it == m_watches.end())
+            continue;
+        Callback callback = it->callback;
+        callback();
+    }
+
+    run_expired_timers();
+}
@@ -0,0 +1,56 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <poll.h>
+#include <vector>
+
+// Minimal poll(2) based loop that multiplexes the X connection with the other
+// file descriptors the window manager cares about (inotify, timers, ...).
+class EventLoop {
+public:
+    using Callback = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+    using TimerId = unsigned long;
+
+    EventLoop() = default;
+    EventLoop(const EventLoop&) = delete;
+    EventLoop operator=(const EventLoop&) = delete;
+
+    ~EventLoop() = default;
+
+    void watch_fd(int, Callback);
+    void unwatch_fd(int);
+
+    // One-shot timers, run from `run_once()` once they expire.
+    TimerId add_timer(std::chrono::milliseconds, Callback);
+    void cancel_timer(TimerId);
+
+    // Blocks until at least one watched fd is readable, a timer expires or the
+    // timeout (in milliseconds) runs out, then runs the ready callbacks.
+    void run_once(int timeout = -1);
+
+private:
+    struct Watch {
+        int fd;
+        Callback callback;
+    };
+
+    struct Timer {
+        TimerId id;
+        Callback callback;
+    };
+
+    void run_expired_timers();
+
+    std::vector<Watch> m_watches;
+    std::vector<pollfd> m_pollfds;
+
+    std::multimap<Clock::time_point, Timer> m_timers;
+    TimerId m_next_timer_id { 1 };
+};
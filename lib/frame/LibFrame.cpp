@@ -0,0 +1,114 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibFrame.h>
+#include <glog/logging.h>
+#include <iterator>
+
+// Free frames beyond this many per visual are destroyed instead of kept.
+static constexpr size_t max_free_per_visual = 32;
+
+FramePool::FramePool(Display* dpy, Window root, size_t prewarm)
+    : m_display(dpy)
+    , m_root_window(root)
+    , m_prewarm(prewarm)
+{
+    int screen = DefaultScreen(m_display);
+    m_default_visual = DefaultVisual(m_display, screen);
+    m_default_depth = DefaultDepth(m_display, screen);
+
+    refill();
+}
+
+FramePool::~FramePool()
+{
+    for (const auto& [visual, frames] : m_free) {
+        for (const auto& frame : frames)
+            destroy(frame);
+    }
+}
+
+Frame FramePool::create(Visual* visual, int depth)
+{
+    Frame frame;
+    frame.visual = XVisualIDFromVisual(visual);
+    frame.depth = depth;
+
+    XSetWindowAttributes wa;
+    // Override redirect so we never end up trying to manage our own frames.
+    wa.override_redirect = true;
+    wa.event_mask = SubstructureRedirectMask | SubstructureNotifyMask;
+    // Non-default depths need all of these set explicitly or the server
+    // answers with BadMatch.
+    wa.border_pixel = 0;
+    wa.background_pixel = 0;
+    unsigned long mask = CWOverrideRedirect | CWEventMask | CWBorderPixel | CWBackPixel;
+
+    if (visual != m_default_visual) {
+        frame.colormap = XCreateColormap(m_display, m_root_window, visual, AllocNone);
+        wa.colormap = frame.colormap;
+        mask |= CWColormap;
+    }
+
+    frame.window = XCreateWindow(m_display, m_root_window, 0, 0, 1, 1, 0, depth, InputOutput, visual, mask, &wa);
+    m_created++;
+
+    return frame;
+}
+
+void FramePool::destroy(const Frame& frame)
+{
+    XDestroyWindow(m_display, frame.window);
+    if (frame.colormap != None)
+        XFreeColormap(m_display, frame.colormap);
+}
+
+Frame FramePool::acquire(Visual* visual, int depth)
+{
+    if (!visual) {
+        visual = m_default_visual;
+        depth = m_default_depth;
+    }
+
+    auto& frames = m_free[XVisualIDFromVisual(visual)];
+    for (auto it = frames.rbegin(); it != frames.rend(); it++) {
+        if (it->depth != depth)
+            continue;
+
+        Frame frame = *it;
+        frames.erase(std::next(it).base());
+        m_reused++;
+        return frame;
+    }
+
+    LOG(INFO) << "Frame pool has no free frame for visual " << XVisualIDFromVisual(visual) << ", creating one ("
+              << m_created << " created, " << m_reused << " reused so far)";
+    return create(visual, depth);
+}
+
+void FramePool::release(const Frame& frame)
+{
+    XUnmapWindow(m_display, frame.window);
+
+    auto& frames = m_free[frame.visual];
+    if (frames.size() >= max_free_per_visual) {
+        destroy(frame);
+        return;
+    }
+
+    frames.push_back(frame);
+}
+
+bool FramePool::needs_refill() const
+{
+    auto it = m_free.find(XVisualIDFromVisual(m_default_visual));
+    return it == m_free.end() || it->second.size() < m_prewarm;
+}
+
+void FramePool::refill()
+{
+    auto& frames = m_free[XVisualIDFromVisual(m_default_visual)];
+    while (frames.size() < m_prewarm)
+        frames.push_back(create(m_default_visual, m_default_depth));
+}
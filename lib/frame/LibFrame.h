@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <X11/Xlib.h>
+#include <unordered_map>
+#include <vector>
+
+// A decoration window clients get reparented into.
+struct Frame {
+    Window window { None };
+    VisualID visual { 0 };
+    int depth { 0 };
+    Colormap colormap { None }; // only set (and owned) for non-default visuals
+};
+
+// Keeps unmapped frame windows around so framing a client doesn't have to wait
+// for a window to be created, and so closing it doesn't destroy one. Frames
+// have to match the visual and depth of the client they hold, so each visual
+// gets its own free list; only the default visual one is filled up front.
+class FramePool {
+public:
+    FramePool(Display*, Window, size_t);
+    FramePool(const FramePool&) = delete;
+    FramePool operator=(const FramePool&) = delete;
+
+    ~FramePool();
+
+    // A null visual means the default one. Only creates a window if there's
+    // no free frame for that visual.
+    Frame acquire(Visual*, int);
+
+    // Takes back a frame whose client has already been taken out of it.
+    void release(const Frame&);
+
+    // Whether the default visual free list dropped below its initial size.
+    bool needs_refill() const;
+    void refill();
+
+private:
+    Frame create(Visual*, int);
+    void destroy(const Frame&);
+
+    Display* m_display;
+    Window m_root_window;
+    size_t m_prewarm;
+
+    Visual* m_default_visual;
+    int m_default_depth;
+
+    std::unordered_map<VisualID, std::vector<Frame>> m_free;
+
+    unsigned long m_created { 0 };
+    unsigned long m_reused { 0 };
+};
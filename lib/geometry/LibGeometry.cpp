@@ -0,0 +1,718 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibGeometry.h>
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+void LayoutResult::resize(size_t n)
+{
+    x.resize(n);
+    y.resize(n);
+    width.resize(n);
+    height.resize(n);
+}
+
+size_t LayoutResult::size() const
+{
+    return x.size();
+}
+
+const char* layout_symbol(Layout layout)
+{
+    switch (layout) {
+    case Layout::Tile:
+        return "[]=";
+    case Layout::Monocle:
+        return "[M]";
+    case Layout::Grid:
+        return "###";
+    case Layout::CenteredMaster:
+        return "|M|";
+    case Layout::Dwindle:
+        return "[\\]";
+    case Layout::Deck:
+        return "[D]";
+    case Layout::Count:
+        break;
+    }
+    return "???";
+}
+
+namespace {
+
+struct Rect {
+    int x, y, width, height;
+};
+
+// The tiled area with the outer gaps taken off, and the gaps to leave
+// between windows.
+struct Area {
+    int x, y, width, height;
+    int gap_h, gap_v;
+};
+
+// Position and length of cell `index` out of `count` cells split evenly over
+// `length` with `gap` between them. The last one takes whatever the division
+// left over.
+inline void split(int start, int length, int gap, int count, int index, int& pos, int& size)
+{
+    int cell = (length - gap * (count - 1)) / count;
+    pos = start + index * (cell + gap);
+    size = index == count - 1 ? start + length - pos : cell;
+}
+
+// A layout is a policy type: constructed once per relayout with the area and
+// the window count, then asked for each window's rectangle in order. The
+// engine below is instantiated per policy, so `place()` gets inlined into
+// the loop.
+
+// The last window of each column takes the rest.
+class TilePolicy {
+public:
+    TilePolicy(const LayoutParams& params, const Area& area, int n)
+        : m_area(area)
+        , m_nm(std::min<int>(params.master_count, n))
+        , m_ns(n - m_nm)
+        , m_master_w(area.width)
+        , m_stack_x(area.x)
+        , m_stack_w(area.width)
+    {
+        if (m_nm && m_ns) {
+            m_master_w = (area.width - area.gap_h) * params.master_size;
+            m_stack_x = area.x + m_master_w + area.gap_h;
+            m_stack_w = area.width - area.gap_h - m_master_w;
+        }
+        m_master_cell = m_nm ? (area.height - area.gap_v * (m_nm - 1)) / m_nm : 0;
+        m_stack_cell = m_ns ? (area.height - area.gap_v * (m_ns - 1)) / m_ns : 0;
+    }
+
+    // Selects only, no branches, so the tile loop still vectorizes.
+    Rect place(int i) const
+    {
+        int master = i < m_nm;
+        int index = i - m_nm * (1 - master);
+        int last = master ? m_nm - 1 : m_ns - 1;
+        int cell = master ? m_master_cell : m_stack_cell;
+
+        int y = m_area.y + index * (cell + m_area.gap_v);
+        int h = index == last ? m_area.y + m_area.height - y : cell;
+        return { master ? m_area.x : m_stack_x, y, master ? m_master_w : m_stack_w, h };
+    }
+
+private:
+    Area m_area;
+    int m_nm, m_ns;
+    int m_master_w, m_stack_x, m_stack_w;
+    int m_master_cell, m_stack_cell;
+};
+
+class MonoclePolicy {
+public:
+    MonoclePolicy(const LayoutParams&, const Area& area, int)
+        : m_area(area)
+    {
+    }
+
+    Rect place(int) const { return { m_area.x, m_area.y, m_area.width, m_area.height }; }
+
+private:
+    Area m_area;
+};
+
+// Row by row, windows in the last row share its width if it isn't full.
+class GridPolicy {
+public:
+    GridPolicy(const LayoutParams&, const Area& area, int n)
+        : m_area(area)
+    {
+        while (m_columns * m_columns < n)
+            m_columns++;
+        m_rows = (n + m_columns - 1) / m_columns;
+        m_last_row_count = n - (m_rows - 1) * m_columns;
+    }
+
+    Rect place(int i) const
+    {
+        int row = i / m_columns;
+        int columns = row == m_rows - 1 ? m_last_row_count : m_columns;
+
+        Rect rect;
+        split(m_area.x, m_area.width, m_area.gap_h, columns, i % m_columns, rect.x, rect.width);
+        split(m_area.y, m_area.height, m_area.gap_v, m_rows, row, rect.y, rect.height);
+        return rect;
+    }
+
+private:
+    Area m_area;
+    int m_columns { 1 };
+    int m_rows;
+    int m_last_row_count;
+};
+
+// With a single stack window it's the tile layout. With more, the first one
+// goes right, the next one left and so on.
+class CenteredMasterPolicy {
+public:
+    CenteredMasterPolicy(const LayoutParams& params, const Area& area, int n)
+        : m_area(area)
+        , m_nm(std::min<int>(params.master_count, n))
+        , m_ns(n - m_nm)
+    {
+        int gap = area.gap_h;
+        if (!m_nm || !m_ns) {
+            m_master = { area.x, area.width };
+            m_left = m_right = m_master;
+        } else if (m_ns == 1) {
+            int master_w = (area.width - gap) * params.master_size;
+            m_master = { area.x, master_w };
+            m_right = { area.x + master_w + gap, area.width - gap - master_w };
+        } else {
+            int master_w = (area.width - 2 * gap) * params.master_size;
+            int left_w = (area.width - 2 * gap - master_w) / 2;
+            m_left = { area.x, left_w };
+            m_master = { area.x + left_w + gap, master_w };
+            m_right = { m_master.x + master_w + gap, area.x + area.width - m_master.x - master_w - gap };
+        }
+
+        // Without a master everything goes in the one column.
+        m_right_count = m_nm && m_ns > 1 ? (m_ns + 1) / 2 : m_ns;
+        m_left_count = m_ns - m_right_count;
+    }
+
+    Rect place(int i) const
+    {
+        Rect rect;
+        if (i < m_nm) {
+            rect.x = m_master.x;
+            rect.width = m_master.width;
+            split(m_area.y, m_area.height, m_area.gap_v, m_nm, i, rect.y, rect.height);
+            return rect;
+        }
+
+        int index = i - m_nm;
+        bool right = !m_left_count || index % 2 == 0;
+        const Column& column = right ? m_right : m_left;
+        rect.x = column.x;
+        rect.width = column.width;
+        split(m_area.y, m_area.height, m_area.gap_v, right ? m_right_count : m_left_count,
+            m_left_count ? index / 2 : index, rect.y, rect.height);
+        return rect;
+    }
+
+private:
+    struct Column {
+        int x, width;
+    };
+
+    Area m_area;
+    int m_nm, m_ns;
+    Column m_master {}, m_left {}, m_right {};
+    int m_right_count, m_left_count;
+};
+
+// Splits side by side first, then one above the other, and so on. The first
+// split uses the master size, the rest halve what's left.
+class DwindlePolicy {
+public:
+    DwindlePolicy(const LayoutParams& params, const Area& area, int n)
+        : m_area(area)
+        , m_n(n)
+        , m_master_size(params.master_size)
+        , m_rest { area.x, area.y, area.width, area.height }
+    {
+    }
+
+    // Each window depends on the previous ones, this one is called in order.
+    Rect place(int i)
+    {
+        if (i == m_n - 1)
+            return m_rest;
+
+        float ratio = i ? 0.5f : m_master_size;
+        Rect rect = m_rest;
+        if (i % 2 == 0) {
+            rect.width = (m_rest.width - m_area.gap_h) * ratio;
+            m_rest.x += rect.width + m_area.gap_h;
+            m_rest.width -= rect.width + m_area.gap_h;
+        } else {
+            rect.height = (m_rest.height - m_area.gap_v) * ratio;
+            m_rest.y += rect.height + m_area.gap_v;
+            m_rest.height -= rect.height + m_area.gap_v;
+        }
+        return rect;
+    }
+
+private:
+    Area m_area;
+    int m_n;
+    float m_master_size;
+    Rect m_rest;
+};
+
+// The tile layout with every stack window taking the whole stack column.
+class DeckPolicy {
+public:
+    DeckPolicy(const LayoutParams& params, const Area& area, int n)
+        : m_tile(params, area, std::min<int>(n, params.master_count + 1))
+        , m_last(std::min<int>(n, params.master_count + 1) - 1)
+    {
+    }
+
+    Rect place(int i) const { return m_tile.place(std::min(i, m_last)); }
+
+private:
+    TilePolicy m_tile;
+    int m_last;
+};
+
+template<typename Policy>
+void arrange_with(const LayoutParams& params, size_t n, LayoutResult& out)
+{
+    out.resize(n);
+    if (!n)
+        return;
+
+    bool gaps = !(params.smart_gaps && n == 1);
+    int oh = gaps ? params.outer_gap_h : 0;
+    int ov = gaps ? params.outer_gap_v : 0;
+    Area area {
+        params.x + oh,
+        params.y + ov,
+        params.width - 2 * oh,
+        params.height - 2 * ov,
+        gaps ? params.inner_gap_h : 0,
+        gaps ? params.inner_gap_v : 0,
+    };
+
+    const int count = static_cast<int>(n);
+    Policy policy(params, area, count);
+    const int border2 = 2 * params.border;
+
+    int32_t* __restrict xs = out.x.data();
+    int32_t* __restrict ys = out.y.data();
+    int32_t* __restrict ws = out.width.data();
+    int32_t* __restrict hs = out.height.data();
+
+    for (int i = 0; i < count; i++) {
+        Rect rect = policy.place(i);
+        int w = rect.width - border2;
+        int h = rect.height - border2;
+
+        xs[i] = rect.x;
+        ys[i] = rect.y;
+        ws[i] = w < 1 ? 1 : w;
+        hs[i] = h < 1 ? 1 : h;
+    }
+}
+
+}
+
+void arrange(const LayoutParams& params, size_t n, LayoutResult& out)
+{
+    switch (params.layout) {
+    case Layout::Tile:
+        return arrange_with<TilePolicy>(params, n, out);
+    case Layout::Monocle:
+        return arrange_with<MonoclePolicy>(params, n, out);
+    case Layout::Grid:
+        return arrange_with<GridPolicy>(params, n, out);
+    case Layout::CenteredMaster:
+        return arrange_with<CenteredMasterPolicy>(params, n, out);
+    case Layout::Dwindle:
+        return arrange_with<DwindlePolicy>(params, n, out);
+    case Layout::Deck:
+        return arrange_with<DeckPolicy>(params, n, out);
+    case Layout::Count:
+        break;
+    }
+    arrange_with<TilePolicy>(params, n, out);
+}
+
+LayoutCache::LayoutCache(size_t capacity)
+    : m_capacity(std::max<size_t>(capacity, 1))
+{
+    m_entries.reserve(m_capacity);
+}
+
+const LayoutResult& LayoutCache::get(const LayoutParams& params, size_t n)
+{
+    m_clock++;
+
+    for (auto& entry : m_entries) {
+        if (entry.count == n && entry.params == params) {
+            m_hits++;
+            entry.last_used = m_clock;
+            return entry.result;
+        }
+    }
+
+    m_misses++;
+
+    Entry* entry;
+    if (m_entries.size() < m_capacity) {
+        entry = &m_entries.emplace_back();
+    } else {
+        entry = &*std::min_element(m_entries.begin(), m_entries.end(),
+            [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+    }
+
+    // Reusing the evicted entry's arrays keeps this from allocating once the
+    // cache has seen a few large layouts.
+    entry->params = params;
+    entry->count = n;
+    entry->last_used = m_clock;
+    arrange(params, n, entry->result);
+    return entry->result;
+}
+
+bool SizeHints::constrains() const
+{
+    return base_width || base_height || min_width || min_height || max_width || max_height || width_inc
+        || height_inc || (min_aspect > 0 && max_aspect > 0);
+}
+
+Size<int> apply_size_hints(const SizeHints& hints, Size<int> size)
+{
+    int width = size.width;
+    int height = size.height;
+
+    // The base size doesn't count towards the aspect ratio, unless it's only
+    // there as the minimum size.
+    bool base_is_min = hints.base_width == hints.min_width && hints.base_height == hints.min_height;
+    if (!base_is_min) {
+        width -= hints.base_width;
+        height -= hints.base_height;
+    }
+
+    if (hints.min_aspect > 0 && hints.max_aspect > 0 && width > 0 && height > 0) {
+        if (hints.max_aspect < static_cast<float>(width) / height)
+            width = height * hints.max_aspect + 0.5f;
+        else if (hints.min_aspect < static_cast<float>(height) / width)
+            height = width * hints.min_aspect + 0.5f;
+    }
+
+    if (base_is_min) {
+        width -= hints.base_width;
+        height -= hints.base_height;
+    }
+
+    if (hints.width_inc > 0)
+        width -= width % hints.width_inc;
+    if (hints.height_inc > 0)
+        height -= height % hints.height_inc;
+
+    width = std::max(width + hints.base_width, static_cast<int>(hints.min_width));
+    height = std::max(height + hints.base_height, static_cast<int>(hints.min_height));
+    if (hints.max_width > 0)
+        width = std::min(width, static_cast<int>(hints.max_width));
+    if (hints.max_height > 0)
+        height = std::min(height, static_cast<int>(hints.max_height));
+
+    return { std::max(width, 1), std::max(height, 1) };
+}
+
+GeometryStore::Handle GeometryStore::add(Window win, Position<int> position, Size<int> size, unsigned int client_tags,
+    uint8_t client_flags)
+{
+    Handle handle;
+    if (!m_free.empty()) {
+        handle = m_free.back();
+        m_free.pop_back();
+    } else {
+        handle = window.size();
+        window.emplace_back();
+        x.emplace_back();
+        y.emplace_back();
+        width.emplace_back();
+        height.emplace_back();
+        prev_width.emplace_back();
+        prev_height.emplace_back();
+        border.emplace_back();
+        tags.emplace_back();
+        flags.emplace_back();
+        z.emplace_back();
+        hints.emplace_back();
+    }
+
+    window[handle] = win;
+    x[handle] = position.x;
+    y[handle] = position.y;
+    width[handle] = size.width;
+    height[handle] = size.height;
+    prev_width[handle] = size.width;
+    prev_height[handle] = size.height;
+    border[handle] = 0;
+    flags[handle] = client_flags | Live;
+    hints[handle] = {};
+    raise(handle);
+
+    tags[handle] = 0;
+    m_history[max_tags].push_back(handle);
+    set_tags(handle, client_tags);
+
+    return handle;
+}
+
+void GeometryStore::remove(Handle handle)
+{
+    set_tags(handle, 0);
+    m_history[max_tags].erase(handle);
+
+    flags[handle] = 0;
+    tags[handle] = 0;
+    window[handle] = None;
+    z[handle] = 0;
+    m_free.push_back(handle);
+}
+
+void GeometryStore::set_tags(Handle handle, unsigned int new_tags)
+{
+    // Joining a tag it's the most recent window there if it's the most recent
+    // one overall (it was just moved there), otherwise the least recent.
+    bool front = m_history[max_tags].front() == handle;
+    unsigned int changed = tags[handle] ^ new_tags;
+    for (size_t tag = 0; tag < max_tags && changed >> tag; tag++) {
+        if (!(changed & (1u << tag)))
+            continue;
+        if (!(new_tags & (1u << tag)))
+            m_history[tag].erase(handle);
+        else if (front)
+            m_history[tag].push_front(handle);
+        else
+            m_history[tag].push_back(handle);
+    }
+    tags[handle] = new_tags;
+}
+
+size_t GeometryStore::slots() const
+{
+    return window.size();
+}
+
+void GeometryStore::filter_by_tags(unsigned int viewed, std::vector<uint8_t>& out) const
+{
+    size_t n = slots();
+    out.resize(n);
+
+    const uint32_t* __restrict t = tags.data();
+    const uint8_t* __restrict f = flags.data();
+    uint8_t* __restrict o = out.data();
+    for (size_t i = 0; i < n; i++) {
+        uint32_t on_viewed = (t[i] & viewed) != 0 ? 1u : 0u;
+        o[i] = static_cast<uint8_t>(on_viewed & f[i] & Live);
+    }
+}
+
+void GeometryStore::raise(Handle handle)
+{
+    if (m_top_z == ~0u)
+        renumber();
+    z[handle] = ++m_top_z;
+}
+
+void GeometryStore::lower(Handle handle)
+{
+    uint32_t bottom = ~0u;
+    for (Handle other = 0; other < slots(); other++) {
+        if (other != handle && (flags[other] & Live))
+            bottom = std::min(bottom, z[other]);
+    }
+
+    if (bottom == ~0u) {
+        raise(handle);
+        return;
+    }
+
+    // Ranks start at 1, 0 is for free slots. Only when the bottom one is
+    // already there does everything have to move up.
+    if (bottom == 1) {
+        for (Handle other = 0; other < slots(); other++) {
+            if (flags[other] & Live)
+                z[other]++;
+        }
+        m_top_z++;
+        bottom++;
+    }
+    z[handle] = bottom - 1;
+}
+
+void GeometryStore::renumber()
+{
+    // Takes four billion raises to get here, squeezes the ranks back down
+    // to 1..n keeping their order.
+    std::vector<Handle> order;
+    for (Handle handle = 0; handle < slots(); handle++) {
+        if (flags[handle] & Live)
+            order.push_back(handle);
+    }
+    std::sort(order.begin(), order.end(), [this](Handle a, Handle b) { return z[a] < z[b]; });
+
+    m_top_z = 0;
+    for (Handle handle : order)
+        z[handle] = ++m_top_z;
+}
+
+bool GeometryStore::restack(const std::vector<uint8_t>& visible, std::vector<Handle>& order)
+{
+    order.clear();
+    for (Handle handle = 0; handle < slots(); handle++) {
+        if (visible[handle] && (flags[handle] & Live))
+            order.push_back(handle);
+    }
+
+    auto key = [this](Handle handle) {
+        return (static_cast<uint64_t>(has(handle, AlwaysOnTop)) << 32) | z[handle];
+    };
+    std::sort(order.begin(), order.end(), [&](Handle a, Handle b) { return key(a) > key(b); });
+
+    // Sorted by rank alone too means nothing on top should move.
+    if (std::is_sorted(order.begin(), order.end(), [this](Handle a, Handle b) { return z[a] > z[b]; }))
+        return false;
+
+    for (auto it = order.rbegin(); it != order.rend(); it++)
+        raise(*it);
+    return true;
+}
+
+GeometryStore::Handle GeometryStore::hit_test(Position<int> point, unsigned int viewed) const
+{
+    size_t n = slots();
+    m_hits.resize(n);
+
+    const int32_t* __restrict xs = x.data();
+    const int32_t* __restrict ys = y.data();
+    const int32_t* __restrict ws = width.data();
+    const int32_t* __restrict hs = height.data();
+    const int32_t* __restrict bs = border.data();
+    const uint32_t* __restrict t = tags.data();
+    const uint8_t* __restrict f = flags.data();
+    const uint32_t* __restrict zs = z.data();
+    uint32_t* __restrict hits = m_hits.data();
+
+    // Scores every slot in one pass, its rank if it contains the point and 0
+    // otherwise, and only then looks for the best one. An early exit would
+    // keep either loop from vectorizing.
+    uint32_t best = 0;
+    for (size_t i = 0; i < n; i++) {
+        int32_t left = xs[i], top = ys[i];
+        int32_t right = left + ws[i] + 2 * bs[i], bottom = top + hs[i] + 2 * bs[i];
+        uint32_t inside = static_cast<uint32_t>(point.x >= left) & static_cast<uint32_t>(point.x < right)
+            & static_cast<uint32_t>(point.y >= top) & static_cast<uint32_t>(point.y < bottom);
+
+        uint32_t flags = f[i];
+        uint32_t on_viewed = (t[i] & viewed) != 0 ? 1u : 0u;
+        uint32_t visible = (flags & Live) & ~(flags >> 4) & on_viewed; // Live and not Hidden
+        uint32_t hit = zs[i] & -(inside & visible);
+        hits[i] = hit;
+        best = hit > best ? hit : best;
+    }
+
+    if (!best)
+        return invalid;
+    return std::find(hits, hits + n, best) - hits;
+}
+
+void GeometryStore::focused(Handle handle)
+{
+    m_history[max_tags].push_front(handle);
+    for (size_t tag = 0; tag < max_tags && tags[handle] >> tag; tag++) {
+        if (tags[handle] & (1u << tag))
+            m_history[tag].push_front(handle);
+    }
+}
+
+const MruList& GeometryStore::history(unsigned int viewed) const
+{
+    if (std::has_single_bit(viewed))
+        return m_history[std::countr_zero(viewed)];
+    return m_history[max_tags];
+}
+
+bool GeometryStore::on_viewed(Handle handle, unsigned int viewed) const
+{
+    return (flags[handle] & Live) && (tags[handle] & viewed);
+}
+
+GeometryStore::Handle GeometryStore::most_recent(unsigned int viewed) const
+{
+    const MruList& list = history(viewed);
+    for (Handle handle = list.front(); handle != MruList::end; handle = list.next(handle)) {
+        if (on_viewed(handle, viewed))
+            return handle;
+    }
+    return invalid;
+}
+
+GeometryStore::Handle GeometryStore::cycle_focus(Handle from, int steps, unsigned int viewed) const
+{
+    const MruList& list = history(viewed);
+    if (list.front() == MruList::end)
+        return invalid;
+
+    Handle handle = list.contains(from) ? from : invalid;
+    for (int step = 0; step < std::abs(steps); step++) {
+        // A full round without finding anything on the viewed tags means
+        // there's nothing there.
+        size_t tries = 0;
+        do {
+            if (++tries > slots())
+                return invalid;
+            if (steps > 0)
+                handle = handle == invalid || list.next(handle) == MruList::end ? list.front() : list.next(handle);
+            else
+                handle = handle == invalid || list.prev(handle) == MruList::end ? list.back() : list.prev(handle);
+        } while (!on_viewed(handle, viewed));
+    }
+    return handle;
+}
+
+void MruList::push_front(uint32_t slot)
+{
+    if (m_front == slot)
+        return;
+    erase(slot);
+
+    m_links[slot] = { end, m_front, true };
+    if (m_front != end)
+        m_links[m_front].prev = slot;
+    else
+        m_back = slot;
+    m_front = slot;
+}
+
+void MruList::push_back(uint32_t slot)
+{
+    if (m_back == slot)
+        return;
+    erase(slot);
+
+    m_links[slot] = { m_back, end, true };
+    if (m_back != end)
+        m_links[m_back].next = slot;
+    else
+        m_front = slot;
+    m_back = slot;
+}
+
+void MruList::erase(uint32_t slot)
+{
+    if (slot >= m_links.size())
+        m_links.resize(slot + 1);
+
+    Link& link = m_links[slot];
+    if (!link.linked)
+        return;
+
+    if (link.prev != end)
+        m_links[link.prev].next = link.next;
+    else
+        m_front = link.next;
+    if (link.next != end)
+        m_links[link.next].prev = link.prev;
+    else
+        m_back = link.prev;
+    link = {};
+}
@@ -0,0 +1,235 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <LibUtil.h>
+#include <X11/Xlib.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using Util::Position;
+using Util::Size;
+
+// How the tiled windows are arranged, picked per tag.
+enum class Layout : uint8_t {
+    Tile,           // master column on the left, stack column on the right
+    Monocle,        // every window takes the whole area
+    Grid,           // rows and columns, as square as it gets
+    CenteredMaster, // master column in the middle, stack split to both sides
+    Dwindle,        // each window takes half of what the previous one left
+    Deck,           // master column, the stack windows on top of each other
+    Count
+};
+
+// Short symbol for the bar.
+const char* layout_symbol(Layout);
+
+// Everything the tiled geometry depends on, so equal parameters always give
+// the same layout.
+struct LayoutParams {
+    Layout layout;
+
+    // The area to tile, without the bar.
+    int x, y, width, height;
+
+    float master_size;
+    unsigned int master_count;
+
+    int inner_gap_h, inner_gap_v; // between windows
+    int outer_gap_h, outer_gap_v; // around the area
+    bool smart_gaps;              // no gaps at all around a single window
+
+    int border;
+
+    bool operator==(const LayoutParams&) const = default;
+};
+
+// Geometry of the tiled windows in layout order (first is master), one array
+// per field.
+struct LayoutResult {
+    std::vector<int32_t> x, y, width, height;
+
+    void resize(size_t);
+    size_t size() const;
+};
+
+// Geometry for that many windows in `params.layout`.
+void arrange(const LayoutParams&, size_t, LayoutResult&);
+
+// From WM_NORMAL_HINTS, zero for whatever the client didn't set. X sizes are
+// 16 bit anyway, this way a client's hints fit in a cache line with room to
+// spare.
+struct SizeHints {
+    int16_t base_width, base_height;
+    int16_t min_width, min_height;
+    int16_t max_width, max_height;
+    int16_t width_inc, height_inc;
+    float min_aspect, max_aspect; // height/width and width/height, as in dwm
+
+    // Whether applying them can change any size at all.
+    bool constrains() const;
+
+    bool operator==(const SizeHints&) const = default;
+};
+
+// The closest size to the given one that the hints allow, the way dwm does
+// it: aspect ratio first, then the increments, then the minimum and maximum.
+Size<int> apply_size_hints(const SizeHints&, Size<int>);
+
+// The last few layouts computed, so going back to a configuration seen
+// recently (a window closing again, switching back to a tag) is a lookup.
+// Least recently used entries make room for new ones.
+class LayoutCache {
+public:
+    explicit LayoutCache(size_t);
+
+    // Computes the layout on a miss, the result stays valid until the next
+    // call.
+    const LayoutResult& get(const LayoutParams&, size_t);
+
+    unsigned long hits() const { return m_hits; }
+    unsigned long misses() const { return m_misses; }
+
+private:
+    struct Entry {
+        LayoutParams params;
+        size_t count;
+        LayoutResult result;
+        unsigned long last_used;
+    };
+
+    // Few enough entries that a linear scan beats hashing.
+    std::vector<Entry> m_entries;
+    size_t m_capacity;
+    unsigned long m_clock { 0 };
+    unsigned long m_hits { 0 };
+    unsigned long m_misses { 0 };
+};
+
+// Slot numbers in most recently used order, as a doubly linked list threaded
+// through an array indexed by slot, so moving one to the front and taking one
+// out are O(1) without allocating.
+class MruList {
+public:
+    static constexpr uint32_t end = ~0u;
+
+    void push_front(uint32_t);
+    void push_back(uint32_t);
+    void erase(uint32_t);
+
+    bool contains(uint32_t slot) const { return slot < m_links.size() && m_links[slot].linked; }
+    uint32_t front() const { return m_front; }
+    uint32_t back() const { return m_back; }
+    uint32_t next(uint32_t slot) const { return m_links[slot].next; }
+    uint32_t prev(uint32_t slot) const { return m_links[slot].prev; }
+
+private:
+    struct Link {
+        uint32_t prev { end };
+        uint32_t next { end };
+        bool linked { false };
+    };
+
+    std::vector<Link> m_links;
+    uint32_t m_front { end };
+    uint32_t m_back { end };
+};
+
+// Geometry and flags of every client, one array per field, so the passes
+// over all of them (layout, filtering by tag, hit testing) only touch the
+// fields they need and compile down to vector loops. Clients hold a handle
+// to their slot; slots of removed clients are reused.
+class GeometryStore {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle invalid = ~0u;
+
+    enum Flag : uint8_t {
+        Live = 1 << 0,
+        Floating = 1 << 1,
+        Fullscreen = 1 << 2,
+        AlwaysOnTop = 1 << 3,
+        Hidden = 1 << 4,      // moved out of sight because its tags aren't viewed
+        Constrained = 1 << 5, // has size hints, see `SizeHints::constrains()`
+    };
+
+    GeometryStore() = default;
+    GeometryStore(const GeometryStore&) = delete;
+    GeometryStore operator=(const GeometryStore&) = delete;
+
+    static constexpr size_t max_tags = 32;
+
+    Handle add(Window, Position<int>, Size<int>, unsigned int, uint8_t);
+    void remove(Handle);
+
+    // Goes through here rather than `tags` so the focus history follows.
+    void set_tags(Handle, unsigned int);
+
+    // Including free ones, the arrays are this long.
+    size_t slots() const;
+
+    bool has(Handle handle, Flag flag) const { return flags[handle] & flag; }
+    void set(Handle handle, Flag flag, bool value)
+    {
+        flags[handle] = value ? (flags[handle] | flag) : (flags[handle] & ~flag);
+    }
+
+    // One byte per slot, set for live clients on any of the tags.
+    void filter_by_tags(unsigned int, std::vector<uint8_t>&) const;
+
+    // Puts the slot above every other one in the stacking order, which is
+    // what the server does on XRaiseWindow and when mapping a new window.
+    void raise(Handle);
+    // Below every other one.
+    void lower(Handle);
+
+    // Live slots set in `visible`, top first, with always-on-top ones above
+    // the rest. Returns whether that differs from the current stacking order,
+    // in which case the order is adopted.
+    bool restack(const std::vector<uint8_t>& visible, std::vector<Handle>&);
+
+    // The topmost window on the viewed tags containing the point, `invalid`
+    // if there's none.
+    Handle hit_test(Position<int>, unsigned int) const;
+
+    // Moves the slot to the front of the focus history, both the whole
+    // monitor's and those of its tags. New slots start out at the back.
+    void focused(Handle);
+    // The most recently focused live slot on the viewed tags, `invalid` if
+    // there's none.
+    Handle most_recent(unsigned int) const;
+    // That many places further back in the focus history than the given slot
+    // (forward if negative) among those on the viewed tags, wrapping around.
+    // Starts from the front for `invalid`.
+    Handle cycle_focus(Handle, int, unsigned int) const;
+
+    std::vector<Window> window;
+    std::vector<int32_t> x;
+    std::vector<int32_t> y;
+    std::vector<int32_t> width;
+    std::vector<int32_t> height;
+    std::vector<int32_t> prev_width;
+    std::vector<int32_t> prev_height;
+    std::vector<int32_t> border;
+    std::vector<uint32_t> tags;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> z; // higher is above, 0 for free slots
+    std::vector<SizeHints> hints;
+
+private:
+    void renumber();
+    // Viewing a single tag, its own history has only slots that are visible.
+    // Otherwise the whole monitor's is filtered.
+    const MruList& history(unsigned int) const;
+    bool on_viewed(Handle, unsigned int) const;
+
+    std::vector<Handle> m_free;
+    // One per tag, the last one for the whole monitor.
+    std::array<MruList, max_tags + 1> m_history;
+    uint32_t m_top_z { 0 };
+    mutable std::vector<uint32_t> m_hits;
+};
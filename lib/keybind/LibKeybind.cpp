@@ -4,6 +4,7 @@
 
 #include <LibClient.h>
 #include <LibKeybind.h>
+#include <LibUtil.h>
 #include <LibWM.h>
 #include <algorithm>
 #include <cerrno>
@@ -20,6 +21,15 @@ Keybind::Keybind(unsigned int modmask, KeySym keysym, KeyAction action, Arg para
 {
 }
 
+Keybind::Keybind(unsigned int modmask, KeySym keysym, std::vector<KeyStroke> chord, KeyAction action, Arg params)
+    : m_modmask(modmask)
+    , m_keysym(keysym)
+    , m_chord(std::move(chord))
+    , m_action(action)
+    , m_params(params)
+{
+}
+
 void Keybind::execute() const
 {
     switch (this->action()) {
@@ -30,10 +40,10 @@ void Keybind::execute() const
         m_kill_client();
         break;
     case KeyAction::StackFocus:
-        m_stack_focus();
+        m_stack_focus(m_params.i);
         break;
     case KeyAction::StackPush:
-        m_stack_push();
+        m_stack_push(m_params.i);
         break;
     case KeyAction::MakeMaster:
         m_make_master();
@@ -71,6 +81,18 @@ void Keybind::execute() const
     case KeyAction::ToggleFullscreen:
         m_toggle_fullscreen();
         break;
+    case KeyAction::Restart:
+        m_restart();
+        break;
+    case KeyAction::ToggleScratchpad:
+        m_toggle_scratchpad(m_params.s);
+        break;
+    case KeyAction::CycleLayout:
+        m_cycle_layout(m_params.i);
+        break;
+    case KeyAction::ToggleOverview:
+        m_toggle_overview();
+        break;
     case KeyAction::Undefined:
         m_undefined();
         break;
@@ -87,6 +109,11 @@ KeySym Keybind::keysym() const
     return m_keysym;
 }
 
+const std::vector<KeyStroke>& Keybind::chord() const
+{
+    return m_chord;
+}
+
 KeyAction Keybind::action() const
 {
     return m_action;
@@ -99,38 +126,46 @@ Arg Keybind::params() const
 
 void Keybind::m_spawn(const char* command) const
 {
-    const char* cmdarg[] = { "/bin/sh", "-c", command, NULL };
-
-    pid_t child = fork();
-
-    if (child == 0) {
-        // child
-        execvp(cmdarg[0], (char**)cmdarg);
-    } else if (child > 0) {
-        // parent
-    } else {
-        // error
+    pid_t pid = WinMan::get().spawn(command);
+    if (pid < 0) {
         LOG(ERROR) << "Could not fork a child proc: " << strerror(errno) << "(errno=" << errno << ")";
         exit(1);
     }
+    WinMan::get().watch_child(pid, command);
 
     LOG(INFO) << "Spawned command `" << command << "`";
 }
 
 void Keybind::m_kill_client() const
 {
-    WinMan::get().currently_focused().kill();
+    if (Client* client = WinMan::get().currently_focused())
+        client->kill();
 }
 
-void Keybind::m_stack_focus() const { }
+void Keybind::m_stack_focus(int steps) const
+{
+    WinMan::get().cycle_focus(steps, m_modmask);
+}
 
-void Keybind::m_stack_push() const { }
+void Keybind::m_stack_push(int steps) const
+{
+    WinMan::get().push_focused(steps);
+}
 
-void Keybind::m_tag_view(unsigned int) const { }
+void Keybind::m_tag_view(unsigned int tags) const
+{
+    WinMan::get().view_tags(tags);
+}
 
-void Keybind::m_tag_toggle(unsigned int) const { }
+void Keybind::m_tag_toggle(unsigned int tags) const
+{
+    WinMan::get().toggle_tags(tags);
+}
 
-void Keybind::m_tag_move_to(unsigned int) const { }
+void Keybind::m_tag_move_to(unsigned int tags) const
+{
+    WinMan::get().move_focused_to_tags(tags);
+}
 
 void Keybind::m_make_master() const { }
 
@@ -142,7 +177,10 @@ void Keybind::m_inc_master_count(int) const { }
 
 void Keybind::m_dec_master_count(int) const { }
 
-void Keybind::m_toggle_float() const { }
+void Keybind::m_toggle_float() const
+{
+    WinMan::get().toggle_floating();
+}
 
 void Keybind::m_toggle_aot() const { }
 
@@ -150,10 +188,84 @@ void Keybind::m_toggle_sticky() const { }
 
 void Keybind::m_toggle_fullscreen() const
 {
-    WinMan::get().currently_focused().toggle_fullscreen();
+    if (Client* client = WinMan::get().currently_focused())
+        client->toggle_fullscreen();
+}
+
+void Keybind::m_restart() const
+{
+    WinMan::get().restart();
+}
+
+void Keybind::m_toggle_scratchpad(const char* name) const
+{
+    WinMan::get().toggle_scratchpad(name);
+}
+
+void Keybind::m_cycle_layout(int direction) const
+{
+    WinMan::get().cycle_layout(direction);
+}
+
+void Keybind::m_toggle_overview() const
+{
+    WinMan::get().toggle_overview();
 }
 
 void Keybind::m_undefined() const
 {
     LOG(INFO) << "Action::Undefined used in Keybinds vector.";
 }
+
+uint64_t KeyTrie::key(unsigned int modmask, KeySym keysym) const
+{
+    return (static_cast<uint64_t>(modmask & m_modifier_mask) << 32) | keysym;
+}
+
+void KeyTrie::build(const std::vector<Keybind>& keybinds, unsigned int modifier_mask)
+{
+    m_modifier_mask = modifier_mask;
+    m_nodes.assign(1, Node {});
+
+    auto child = [this](unsigned int node, const KeyStroke& stroke) {
+        auto [it, inserted] = m_nodes[node].children.try_emplace(key(stroke.modmask, stroke.keysym), m_nodes.size());
+        if (inserted)
+            m_nodes.emplace_back();
+        return it->second;
+    };
+
+    for (const auto& keybind : keybinds) {
+        unsigned int node = child(root, { keybind.modmask(), keybind.keysym() });
+        for (const auto& stroke : keybind.chord())
+            node = child(node, stroke);
+
+        if (m_nodes[node].binding)
+            LOG(WARNING) << "Key " << XKeysymToString(keybind.keysym()) << " is bound more than once, using the last one";
+        m_nodes[node].binding = &keybind;
+    }
+
+    for (const auto& node : m_nodes) {
+        if (node.binding && !node.children.empty())
+            LOG(WARNING) << "Binding for " << XKeysymToString(node.binding->keysym())
+                         << " is shadowed by a chord starting with it";
+    }
+}
+
+std::optional<unsigned int> KeyTrie::step(unsigned int node, unsigned int modmask, KeySym keysym) const
+{
+    const auto& children = m_nodes[node].children;
+    auto it = children.find(key(modmask, keysym));
+    if (it == children.end())
+        return {};
+    return it->second;
+}
+
+bool KeyTrie::has_children(unsigned int node) const
+{
+    return !m_nodes[node].children.empty();
+}
+
+const Keybind* KeyTrie::binding(unsigned int node) const
+{
+    return m_nodes[node].binding;
+}
@@ -7,8 +7,11 @@
 #include <X11/XF86keysym.h>
 #include <X11/Xlib.h>
 #include <X11/keysym.h>
+#include <cstdint>
 #include <map>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 static constexpr unsigned int nomod = 0;
@@ -32,6 +35,10 @@ enum class KeyAction {
     DecMasterSize,
     IncMasterCount,
     DecMasterCount,
+    Restart,
+    ToggleScratchpad,
+    CycleLayout,
+    ToggleOverview,
     Undefined
 };
 
@@ -43,14 +50,22 @@ union Arg {
     const char* s;
 };
 
+struct KeyStroke {
+    unsigned int modmask;
+    KeySym keysym;
+};
+
 class Keybind {
 public:
     Keybind(unsigned int, KeySym, KeyAction, Arg);
+    // A chord: the first key, then the keys that have to follow it.
+    Keybind(unsigned int, KeySym, std::vector<KeyStroke>, KeyAction, Arg);
 
     ~Keybind() = default;
 
     unsigned int modmask() const;
     KeySym keysym() const;
+    const std::vector<KeyStroke>& chord() const;
     KeyAction action() const;
     Arg params() const;
 
@@ -59,8 +74,8 @@ public:
 private:
     void m_spawn(const char*) const;
     void m_kill_client() const;
-    void m_stack_focus() const;
-    void m_stack_push() const;
+    void m_stack_focus(int) const;
+    void m_stack_push(int) const;
     void m_tag_view(unsigned int) const;
     void m_tag_toggle(unsigned int) const;
     void m_tag_move_to(unsigned int) const;
@@ -73,10 +88,46 @@ private:
     void m_toggle_aot() const;
     void m_toggle_sticky() const;
     void m_toggle_fullscreen() const;
+    void m_restart() const;
+    void m_toggle_scratchpad(const char*) const;
+    void m_cycle_layout(int) const;
+    void m_toggle_overview() const;
     void m_undefined() const;
 
     unsigned int m_modmask;
     KeySym m_keysym;
+    std::vector<KeyStroke> m_chord;
     KeyAction m_action;
     Arg m_params;
 };
+
+// All keybinds folded into a trie keyed by (modmask, keysym), so dispatching a
+// key is a single hash lookup whether it's a plain binding or a step of a
+// chord. Nodes refer to the keybinds they were built from, so the trie has to
+// be rebuilt whenever that vector changes.
+class KeyTrie {
+public:
+    static constexpr unsigned int root = 0;
+
+    // Only the modifiers in the mask are told apart, the rest (lock keys)
+    // are ignored both here and in `step()`.
+    void build(const std::vector<Keybind>&, unsigned int);
+
+    // The node reached by pressing the key in the given node, if any.
+    std::optional<unsigned int> step(unsigned int, unsigned int, KeySym) const;
+
+    // Whether more keys can follow, i.e. a chord is in progress.
+    bool has_children(unsigned int) const;
+    const Keybind* binding(unsigned int) const;
+
+private:
+    struct Node {
+        const Keybind* binding { nullptr };
+        std::unordered_map<uint64_t, unsigned int> children;
+    };
+
+    uint64_t key(unsigned int, KeySym) const;
+
+    std::vector<Node> m_nodes;
+    unsigned int m_modifier_mask { 0 };
+};
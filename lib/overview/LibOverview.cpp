@@ -0,0 +1,362 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibOverview.h>
+#include <LibTrace.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/render.h>
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+
+// Maps destination coordinates to source ones, so scaling down by `scale`
+// takes the inverse.
+static void set_scale(Display* display, Picture picture, double scale)
+{
+    XTransform transform = { {
+        { XDoubleToFixed(1 / scale), 0, 0 },
+        { 0, XDoubleToFixed(1 / scale), 0 },
+        { 0, 0, XDoubleToFixed(1) },
+    } };
+    XRenderSetPictureTransform(display, picture, &transform);
+}
+
+Overview::Overview(Display* display, Window root, Size<int> screen, int thumbnail_size)
+    : m_display(display)
+    , m_root(root)
+    , m_screen(screen)
+    , m_thumbnail_size(thumbnail_size)
+{
+    int event_base, error_base, major, minor;
+
+    major = 0, minor = 2;
+    if (!XCompositeQueryExtension(m_display, &event_base, &error_base)
+        || !XCompositeQueryVersion(m_display, &major, &minor)) {
+        LOG(INFO) << "No Composite extension, the overview is disabled";
+        return;
+    }
+
+    major = 1, minor = 1;
+    if (!XDamageQueryExtension(m_display, &event_base, &error_base)
+        || !XDamageQueryVersion(m_display, &major, &minor)) {
+        LOG(INFO) << "No Damage extension, the overview is disabled";
+        return;
+    }
+    m_damage_event = event_base + XDamageNotify;
+    m_damage_error = error_base + BadDamage;
+
+    major = 2, minor = 0;
+    if (!XFixesQueryExtension(m_display, &event_base, &error_base)
+        || !XFixesQueryVersion(m_display, &major, &minor)) {
+        LOG(INFO) << "No XFixes extension, the overview is disabled";
+        return;
+    }
+
+    if (!XRenderQueryExtension(m_display, &event_base, &error_base)) {
+        LOG(INFO) << "No Render extension, the overview is disabled";
+        return;
+    }
+    m_render_error = error_base + BadPicture;
+
+    m_thumbnail_format = XRenderFindStandardFormat(m_display, PictStandardRGB24);
+    m_repair = XFixesCreateRegion(m_display, nullptr, 0);
+
+    // The server still draws the screen itself, only now every window's
+    // contents are kept around for us to scale down.
+    XCompositeRedirectSubwindows(m_display, m_root, CompositeRedirectAutomatic);
+    m_enabled = true;
+}
+
+bool Overview::enabled() const
+{
+    return m_enabled;
+}
+
+int Overview::damage_event() const
+{
+    return m_damage_event;
+}
+
+bool Overview::owns_error(const XErrorEvent& err) const
+{
+    return m_enabled && (err.error_code == m_damage_error || err.error_code == m_render_error);
+}
+
+void Overview::set_colors(const XColor& background, const XColor& selection)
+{
+    m_background = { background.red, background.green, background.blue, 0xffff };
+    m_selection = { selection.red, selection.green, selection.blue, 0xffff };
+}
+
+void Overview::add(Window window, Visual* visual, Size<int> size)
+{
+    if (!m_enabled || m_thumbnails.contains(window))
+        return;
+
+    XRenderPictFormat* format = XRenderFindVisualFormat(m_display, visual);
+    if (!format)
+        return;
+
+    Thumbnail& thumbnail = m_thumbnails[window];
+
+    // Children drawn into the window count as its contents too.
+    XRenderPictureAttributes attributes;
+    attributes.subwindow_mode = IncludeInferiors;
+    thumbnail.source = XRenderCreatePicture(m_display, window, format, CPSubwindowMode, &attributes);
+    XRenderSetPictureFilter(m_display, thumbnail.source, FilterGood, nullptr, 0);
+
+    // A notify whenever the bounding box of what's damaged grows, carrying
+    // that box, so keeping track of it takes no round trips.
+    thumbnail.damage = XDamageCreate(m_display, window, XDamageReportBoundingBox);
+
+    resize(thumbnail, size);
+    m_dirty.push_back(window);
+}
+
+void Overview::remove(Window window)
+{
+    auto it = m_thumbnails.find(window);
+    if (it == m_thumbnails.end())
+        return;
+
+    // The server frees the damage and source picture along with a destroyed
+    // window, `owns_error()` covers that.
+    Thumbnail& thumbnail = it->second;
+    XDamageDestroy(m_display, thumbnail.damage);
+    XRenderFreePicture(m_display, thumbnail.source);
+    XRenderFreePicture(m_display, thumbnail.picture);
+    XFreePixmap(m_display, thumbnail.pixmap);
+    m_thumbnails.erase(it);
+
+    // Its cell is left empty.
+    if (is_open())
+        m_needs_redraw = true;
+}
+
+void Overview::resize(Thumbnail& thumbnail, Size<int> size)
+{
+    if (thumbnail.picture != None) {
+        XRenderFreePicture(m_display, thumbnail.picture);
+        XFreePixmap(m_display, thumbnail.pixmap);
+    }
+
+    size.width = std::max(size.width, 1);
+    size.height = std::max(size.height, 1);
+    thumbnail.window_size = size;
+    thumbnail.scale = std::min({ 1.0, static_cast<double>(m_thumbnail_size) / size.width,
+        static_cast<double>(m_thumbnail_size) / size.height });
+    thumbnail.size = { std::max(1, static_cast<int>(std::lround(size.width * thumbnail.scale))),
+        std::max(1, static_cast<int>(std::lround(size.height * thumbnail.scale))) };
+
+    thumbnail.pixmap = XCreatePixmap(m_display, m_root, thumbnail.size.width, thumbnail.size.height,
+        m_thumbnail_format->depth);
+    thumbnail.picture = XRenderCreatePicture(m_display, thumbnail.pixmap, m_thumbnail_format, 0, nullptr);
+    XRenderSetPictureFilter(m_display, thumbnail.picture, FilterGood, nullptr, 0);
+    set_scale(m_display, thumbnail.source, thumbnail.scale);
+
+    // Nothing in the new pixmap yet.
+    thumbnail.dirty = true;
+    thumbnail.x1 = 0;
+    thumbnail.y1 = 0;
+    thumbnail.x2 = size.width;
+    thumbnail.y2 = size.height;
+}
+
+void Overview::damaged(const XDamageNotifyEvent& e)
+{
+    auto it = m_thumbnails.find(e.drawable);
+    if (it == m_thumbnails.end())
+        return;
+
+    Thumbnail& thumbnail = it->second;
+    bool was_dirty = thumbnail.dirty;
+
+    if (e.geometry.width != thumbnail.window_size.width || e.geometry.height != thumbnail.window_size.height) {
+        resize(thumbnail, { e.geometry.width, e.geometry.height });
+    } else if (!thumbnail.dirty) {
+        thumbnail.dirty = true;
+        thumbnail.x1 = e.area.x;
+        thumbnail.y1 = e.area.y;
+        thumbnail.x2 = e.area.x + e.area.width;
+        thumbnail.y2 = e.area.y + e.area.height;
+    } else {
+        thumbnail.x1 = std::min(thumbnail.x1, static_cast<int>(e.area.x));
+        thumbnail.y1 = std::min(thumbnail.y1, static_cast<int>(e.area.y));
+        thumbnail.x2 = std::max(thumbnail.x2, e.area.x + e.area.width);
+        thumbnail.y2 = std::max(thumbnail.y2, e.area.y + e.area.height);
+    }
+
+    if (!was_dirty)
+        m_dirty.push_back(e.drawable);
+}
+
+void Overview::refresh(Window window, Thumbnail& thumbnail)
+{
+    // Only what we know of counts as repaired. Damage reported meanwhile
+    // stays, and the server sends another notify for it.
+    XRectangle box { static_cast<short>(thumbnail.x1), static_cast<short>(thumbnail.y1),
+        static_cast<unsigned short>(thumbnail.x2 - thumbnail.x1),
+        static_cast<unsigned short>(thumbnail.y2 - thumbnail.y1) };
+    XFixesSetRegion(m_display, m_repair, &box, 1);
+    XDamageSubtract(m_display, thumbnail.damage, m_repair, None);
+
+    // Rounded outwards, so filtering at the edges picks up the change too.
+    int x = std::max(0, static_cast<int>(std::floor(thumbnail.x1 * thumbnail.scale)) - 1);
+    int y = std::max(0, static_cast<int>(std::floor(thumbnail.y1 * thumbnail.scale)) - 1);
+    int right = std::min(thumbnail.size.width, static_cast<int>(std::ceil(thumbnail.x2 * thumbnail.scale)) + 1);
+    int bottom = std::min(thumbnail.size.height, static_cast<int>(std::ceil(thumbnail.y2 * thumbnail.scale)) + 1);
+    if (right > x && bottom > y)
+        XRenderComposite(m_display, PictOpSrc, thumbnail.source, None, thumbnail.picture, x, y, 0, 0, x, y, right - x,
+            bottom - y);
+
+    thumbnail.dirty = false;
+
+    if (is_open() && std::find(m_shown.begin(), m_shown.end(), window) != m_shown.end())
+        m_needs_redraw = true;
+}
+
+void Overview::update()
+{
+    if (m_dirty.empty() && !m_needs_redraw)
+        return;
+
+    TRACE_SPAN("Overview::update");
+
+    for (Window window : m_dirty) {
+        auto it = m_thumbnails.find(window);
+        if (it != m_thumbnails.end() && it->second.dirty)
+            refresh(window, it->second);
+    }
+    m_dirty.clear();
+
+    if (m_needs_redraw && is_open())
+        draw();
+    m_needs_redraw = false;
+}
+
+bool Overview::is_open() const
+{
+    return m_window != None;
+}
+
+void Overview::open(const std::vector<Window>& windows, Window selected)
+{
+    if (!m_enabled || is_open())
+        return;
+
+    m_shown.clear();
+    m_selected = 0;
+    for (Window window : windows) {
+        if (!m_thumbnails.contains(window))
+            continue;
+        if (window == selected)
+            m_selected = m_shown.size();
+        m_shown.push_back(window);
+    }
+    if (m_shown.empty())
+        return;
+
+    // Same as the grid layout, gaps included.
+    int gap = std::max(16, m_thumbnail_size / 8);
+    LayoutParams params { Layout::Grid, 0, 0, m_screen.width, m_screen.height, 0.5, 1, gap, gap, gap * 2, gap * 2,
+        false, 0 };
+    arrange(params, m_shown.size(), m_cells);
+
+    XSetWindowAttributes attributes;
+    attributes.override_redirect = True;
+    attributes.event_mask = KeyPressMask | ButtonPressMask | ExposureMask;
+    m_window = XCreateWindow(m_display, m_root, 0, 0, m_screen.width, m_screen.height, 0, CopyFromParent,
+        InputOutput, CopyFromParent, CWOverrideRedirect | CWEventMask, &attributes);
+    XMapRaised(m_display, m_window);
+
+    Visual* visual = DefaultVisual(m_display, DefaultScreen(m_display));
+    m_window_picture = XRenderCreatePicture(m_display, m_window, XRenderFindVisualFormat(m_display, visual), 0,
+        nullptr);
+
+    XGrabKeyboard(m_display, m_window, True, GrabModeAsync, GrabModeAsync, CurrentTime);
+    m_needs_redraw = true;
+}
+
+void Overview::close()
+{
+    if (!is_open())
+        return;
+
+    XUngrabKeyboard(m_display, CurrentTime);
+    XRenderFreePicture(m_display, m_window_picture);
+    XDestroyWindow(m_display, m_window);
+    m_window_picture = None;
+    m_window = None;
+    m_shown.clear();
+}
+
+Window Overview::window() const
+{
+    return m_window;
+}
+
+void Overview::expose()
+{
+    m_needs_redraw = true;
+}
+
+void Overview::move_selection(int delta)
+{
+    if (m_shown.empty())
+        return;
+
+    int count = m_shown.size();
+    m_selected = ((static_cast<int>(m_selected) + delta) % count + count) % count;
+    m_needs_redraw = true;
+}
+
+Window Overview::selected() const
+{
+    return m_shown.empty() ? None : m_shown[m_selected];
+}
+
+Window Overview::window_at(Position<int> pos) const
+{
+    for (size_t i = 0; i < m_shown.size(); i++) {
+        if (pos.x >= m_cells.x[i] && pos.x < m_cells.x[i] + m_cells.width[i] && pos.y >= m_cells.y[i]
+            && pos.y < m_cells.y[i] + m_cells.height[i])
+            return m_shown[i];
+    }
+    return None;
+}
+
+void Overview::draw()
+{
+    TRACE_SPAN("Overview::draw");
+
+    XRenderFillRectangle(m_display, PictOpSrc, m_window_picture, &m_background, 0, 0, m_screen.width,
+        m_screen.height);
+
+    for (size_t i = 0; i < m_shown.size(); i++) {
+        auto it = m_thumbnails.find(m_shown[i]);
+        if (it == m_thumbnails.end())
+            continue;
+        const Thumbnail& thumbnail = it->second;
+
+        // Scaled again to fit the cell, from the thumbnail this time.
+        double scale = std::min(static_cast<double>(m_cells.width[i]) / thumbnail.size.width,
+            static_cast<double>(m_cells.height[i]) / thumbnail.size.height);
+        int width = std::max(1, static_cast<int>(thumbnail.size.width * scale));
+        int height = std::max(1, static_cast<int>(thumbnail.size.height * scale));
+        int x = m_cells.x[i] + (m_cells.width[i] - width) / 2;
+        int y = m_cells.y[i] + (m_cells.height[i] - height) / 2;
+
+        if (i == m_selected) {
+            int border = 4;
+            XRenderFillRectangle(m_display, PictOpSrc, m_window_picture, &m_selection, x - border, y - border,
+                width + 2 * border, height + 2 * border);
+        }
+
+        set_scale(m_display, thumbnail.picture, scale);
+        XRenderComposite(m_display, PictOpSrc, thumbnail.picture, None, m_window_picture, 0, 0, 0, 0, x, y, width,
+            height);
+        set_scale(m_display, thumbnail.picture, 1);
+    }
+}
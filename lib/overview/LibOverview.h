@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <LibGeometry.h>
+#include <LibUtil.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xrender.h>
+#include <unordered_map>
+#include <vector>
+
+using Util::Position;
+using Util::Size;
+
+// Every client window is redirected (automatically, the server still paints
+// the screen) so its contents are kept off-screen, and a downscaled copy of
+// it is kept up to date from the regions Damage reports. The overview draws
+// those copies into a window covering the screen, which is all server-side
+// XRender compositing: nothing is ever read back.
+class Overview {
+public:
+    // Disabled if any of Composite, Damage, XFixes or Render is missing.
+    Overview(Display*, Window, Size<int>, int);
+    Overview(const Overview&) = delete;
+    Overview operator=(const Overview&) = delete;
+
+    // The server frees everything along with the connection.
+    ~Overview() = default;
+
+    bool enabled() const;
+
+    // The event type of DamageNotify.
+    int damage_event() const;
+    // Errors about our Damage objects and Pictures, which the server frees
+    // along with their window, so they can be gone before we free them.
+    bool owns_error(const XErrorEvent&) const;
+
+    void set_colors(const XColor&, const XColor&);
+
+    void add(Window, Visual*, Size<int>);
+    void remove(Window);
+
+    // Only noted, `update()` does the work once per batch of events.
+    void damaged(const XDamageNotifyEvent&);
+    // Brings the damaged parts of the thumbnails up to date, and the
+    // overview if it's open.
+    void update();
+
+    bool is_open() const;
+    // Shows these windows' thumbnails, in that order.
+    void open(const std::vector<Window>&, Window);
+    void close();
+    // The overview window, input goes there while it's open.
+    Window window() const;
+    void expose();
+
+    void move_selection(int);
+    Window selected() const;
+    Window window_at(Position<int>) const;
+
+private:
+    struct Thumbnail {
+        Damage damage { None };
+        Picture source { None };   // the window's contents
+        Pixmap pixmap { None };
+        Picture picture { None };  // the downscaled copy
+        Size<int> window_size { 0, 0 };
+        Size<int> size { 0, 0 };
+        double scale { 1 };
+        // Damaged since the last update, in window coordinates.
+        bool dirty { false };
+        int x1 { 0 }, y1 { 0 }, x2 { 0 }, y2 { 0 };
+    };
+
+    void resize(Thumbnail&, Size<int>);
+    void refresh(Window, Thumbnail&);
+    void draw();
+
+    Display* m_display;
+    Window m_root;
+    Size<int> m_screen;
+    int m_thumbnail_size;
+
+    bool m_enabled { false };
+    int m_damage_event { -1 };
+    int m_damage_error { -1 };
+    int m_render_error { -1 };
+
+    XRenderPictFormat* m_thumbnail_format { nullptr };
+    // Scratch region for subtracting repaired damage.
+    XserverRegion m_repair { None };
+
+    std::unordered_map<Window, Thumbnail> m_thumbnails;
+    std::vector<Window> m_dirty;
+
+    XRenderColor m_background {};
+    XRenderColor m_selection {};
+
+    Window m_window { None };
+    Picture m_window_picture { None };
+    std::vector<Window> m_shown;
+    LayoutResult m_cells;
+    size_t m_selected { 0 };
+    bool m_needs_redraw { false };
+};
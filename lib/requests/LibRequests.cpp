@@ -0,0 +1,59 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibRequests.h>
+#include <X11/Xproto.h>
+
+RequestLog::RequestLog(size_t capacity)
+    : m_entries(capacity)
+{
+}
+
+void RequestLog::mark(unsigned long serial, Window window, const char* operation)
+{
+    if (m_count) {
+        Entry& last = m_entries[(m_next + m_entries.size() - 1) % m_entries.size()];
+        if (last.serial == serial) {
+            last = { serial, window, operation };
+            return;
+        }
+    }
+
+    m_entries[m_next] = { serial, window, operation };
+    m_next = (m_next + 1) % m_entries.size();
+    if (m_count < m_entries.size())
+        m_count++;
+}
+
+const RequestLog::Entry* RequestLog::find(unsigned long serial) const
+{
+    // Newest first, the request that failed is almost always a recent one.
+    for (size_t i = 1; i <= m_count; i++) {
+        const Entry& entry = m_entries[(m_next + m_entries.size() - i) % m_entries.size()];
+        if (entry.serial <= serial)
+            return &entry;
+    }
+    return nullptr;
+}
+
+XErrorKind classify_x_error(const XErrorEvent& err)
+{
+    switch (err.error_code) {
+    case BadWindow:
+    case BadDrawable:
+        return XErrorKind::WindowGone;
+    case BadMatch:
+        // Focusing a window that got unmapped meanwhile, or configuring one
+        // relative to a sibling that's gone.
+        if (err.request_code == X_SetInputFocus || err.request_code == X_ConfigureWindow)
+            return XErrorKind::Race;
+        break;
+    case BadAccess:
+        // Another client holds the grab already.
+        if (err.request_code == X_GrabButton || err.request_code == X_GrabKey)
+            return XErrorKind::Race;
+        break;
+    }
+    return XErrorKind::Bug;
+}
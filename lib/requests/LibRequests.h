@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <X11/Xlib.h>
+#include <cstddef>
+#include <vector>
+
+// Remembers which operation, on behalf of which window, sent the requests
+// starting at a given serial, so an error coming back asynchronously can be
+// traced to what caused it. Only the most recent entries are kept, errors
+// arrive long before the log wraps around.
+class RequestLog {
+public:
+    struct Entry {
+        unsigned long serial;
+        Window window;
+        const char* operation;
+    };
+
+    explicit RequestLog(size_t);
+
+    // Requests from `serial` on belong to this operation. Marking the same
+    // serial again replaces the entry, nothing was sent in between.
+    void mark(unsigned long serial, Window, const char*);
+
+    // The entry the request with that serial belongs to, nullptr if it's
+    // older than anything still in the log.
+    const Entry* find(unsigned long) const;
+
+private:
+    std::vector<Entry> m_entries;
+    size_t m_next { 0 };
+    size_t m_count { 0 };
+};
+
+// What an error means for us.
+enum class XErrorKind {
+    WindowGone, // the window was destroyed before the server got to our request
+    Race,       // the window changed state in the meantime (unmapped, ...)
+    Bug,        // a request that can't have been right in the first place
+};
+
+XErrorKind classify_x_error(const XErrorEvent&);
@@ -0,0 +1,185 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibSession.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t session_magic = 0x6d77702b; // "+pwm"
+constexpr uint16_t session_version = 4;
+
+enum ClientFlags : uint8_t {
+    Fullscreen = 1 << 0,
+    AlwaysOnTop = 1 << 1,
+    FocusLocked = 1 << 2,
+    Floating = 1 << 3,
+};
+
+struct [[gnu::packed]] Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t client_count;
+    uint16_t scratchpad_count;
+    uint16_t layout_count;
+    uint32_t focused;
+    uint32_t selected_tags;
+    float master_size;
+};
+
+struct [[gnu::packed]] Record {
+    uint32_t window;
+    int16_t x, y;
+    uint16_t width, height;
+    uint16_t prev_width, prev_height;
+    uint32_t tags;
+    uint8_t flags;
+};
+
+struct [[gnu::packed]] ScratchpadRecord {
+    int32_t pid;
+    uint32_t window;
+};
+
+}
+
+int SessionState::write_to_memfd() const
+{
+    // No MFD_CLOEXEC, the whole point is for the fd to survive exec().
+    int fd = memfd_create("pluswm-session", 0);
+    if (fd < 0) {
+        LOG(ERROR) << "memfd_create() failed: " << strerror(errno) << " (errno=" << errno << ")";
+        return -1;
+    }
+
+    std::vector<uint8_t> buffer(
+        sizeof(Header) + clients.size() * sizeof(Record) + scratchpads.size() * sizeof(ScratchpadRecord)
+        + layouts.size());
+
+    Header header {
+        session_magic,
+        session_version,
+        static_cast<uint16_t>(clients.size()),
+        static_cast<uint16_t>(scratchpads.size()),
+        static_cast<uint16_t>(layouts.size()),
+        static_cast<uint32_t>(focused),
+        selected_tags,
+        master_size,
+    };
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    uint8_t* ptr = buffer.data() + sizeof(Header);
+    for (const auto& client : clients) {
+        Record record {
+            static_cast<uint32_t>(client.window),
+            static_cast<int16_t>(client.position.x),
+            static_cast<int16_t>(client.position.y),
+            static_cast<uint16_t>(client.size.width),
+            static_cast<uint16_t>(client.size.height),
+            static_cast<uint16_t>(client.prev_size.width),
+            static_cast<uint16_t>(client.prev_size.height),
+            client.tags,
+            static_cast<uint8_t>((client.is_fullscreen ? Fullscreen : 0)
+                | (client.is_aot ? AlwaysOnTop : 0)
+                | (client.focus_locked ? FocusLocked : 0)
+                | (client.is_floating ? Floating : 0)),
+        };
+        memcpy(ptr, &record, sizeof(record));
+        ptr += sizeof(record);
+    }
+
+    for (const auto& scratchpad : scratchpads) {
+        ScratchpadRecord record { scratchpad.pid, static_cast<uint32_t>(scratchpad.window) };
+        memcpy(ptr, &record, sizeof(record));
+        ptr += sizeof(record);
+    }
+
+    for (Layout layout : layouts)
+        *ptr++ = static_cast<uint8_t>(layout);
+
+    if (write(fd, buffer.data(), buffer.size()) != static_cast<ssize_t>(buffer.size())) {
+        LOG(ERROR) << "Could not write session state: " << strerror(errno) << " (errno=" << errno << ")";
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+std::optional<SessionState> SessionState::read_from_fd(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        LOG(WARNING) << "Session state fd " << fd << " is not usable";
+        close(fd);
+        return {};
+    }
+
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LOG(WARNING) << "Could not map session state: " << strerror(errno);
+        return {};
+    }
+
+    const auto* data = static_cast<const uint8_t*>(addr);
+    size_t size = st.st_size;
+
+    Header header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != session_magic || header.version != session_version
+        || size < sizeof(Header) + header.client_count * sizeof(Record)
+                + header.scratchpad_count * sizeof(ScratchpadRecord) + header.layout_count) {
+        LOG(WARNING) << "Ignoring session state with unknown format";
+        munmap(addr, size);
+        return {};
+    }
+
+    SessionState state;
+    state.focused = header.focused;
+    state.selected_tags = header.selected_tags;
+    state.master_size = header.master_size;
+    state.clients.reserve(header.client_count);
+
+    const uint8_t* ptr = data + sizeof(Header);
+    for (unsigned int i = 0; i < header.client_count; i++) {
+        Record record;
+        memcpy(&record, ptr, sizeof(record));
+        ptr += sizeof(record);
+
+        ClientState client;
+        client.window = record.window;
+        client.position = { record.x, record.y };
+        client.size = { record.width, record.height };
+        client.prev_size = { record.prev_width, record.prev_height };
+        client.tags = record.tags;
+        client.is_fullscreen = record.flags & Fullscreen;
+        client.is_aot = record.flags & AlwaysOnTop;
+        client.focus_locked = record.flags & FocusLocked;
+        client.is_floating = record.flags & Floating;
+        state.clients.push_back(client);
+    }
+
+    state.scratchpads.reserve(header.scratchpad_count);
+    for (unsigned int i = 0; i < header.scratchpad_count; i++) {
+        ScratchpadRecord record;
+        memcpy(&record, ptr, sizeof(record));
+        ptr += sizeof(record);
+
+        state.scratchpads.push_back({ record.pid, record.window });
+    }
+
+    for (unsigned int i = 0; i < header.layout_count; i++)
+        state.layouts.push_back(static_cast<Layout>(*ptr++));
+
+    munmap(addr, size);
+    return state;
+}
@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <LibClient.h>
+#include <LibGeometry.h>
+#include <X11/Xlib.h>
+#include <optional>
+#include <sys/types.h>
+#include <vector>
+
+// A scratchpad's process outlives the restart (it stays our child across
+// exec()), so it must not be started a second time.
+struct ScratchpadState {
+    pid_t pid { -1 };
+    Window window { None };
+};
+
+// Everything needed to pick up the windows again after re-executing ourselves,
+// without asking the X server about each of them.
+struct SessionState {
+    float master_size { 0 };
+    unsigned int selected_tags { 1 };
+    Window focused { None };
+
+    // One per tag.
+    std::vector<Layout> layouts;
+
+    // In stacking order, same as `WinMan::m_stack`.
+    std::vector<ClientState> clients;
+
+    // Same order as `Config::scratchpads`.
+    std::vector<ScratchpadState> scratchpads;
+
+    // Writes the state into an anonymous memfd that survives exec() and
+    // returns it, or -1 on failure.
+    int write_to_memfd() const;
+
+    // Reads (and closes) a memfd created by `write_to_memfd()`.
+    static std::optional<SessionState> read_from_fd(int);
+};
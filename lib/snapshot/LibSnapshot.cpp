@@ -0,0 +1,161 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibSnapshot.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Snapshot {
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "readers in other processes need plain words");
+
+static Segment* map_segment(const std::string& name, bool create)
+{
+    std::string path = "/" + name;
+    int fd = shm_open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+    if (fd < 0)
+        return nullptr;
+
+    if (create && ftruncate(fd, sizeof(Segment)) < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* memory = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return memory == MAP_FAILED ? nullptr : static_cast<Segment*>(memory);
+}
+
+// How much of the state is in use, the rest of the client array isn't
+// compared or copied.
+static size_t used_size(const State& state)
+{
+    return offsetof(State, clients) + state.client_count * sizeof(Client);
+}
+
+std::string segment_name(const char* display)
+{
+    std::string name = "pluswm-";
+    for (const char* c = display ? display : ":0"; *c; c++)
+        name += *c == '/' ? '_' : *c;
+    return name;
+}
+
+Writer::~Writer()
+{
+    if (m_segment)
+        munmap(m_segment, sizeof(Segment));
+}
+
+bool Writer::open(const std::string& name)
+{
+    m_segment = map_segment(name, true);
+    if (!m_segment) {
+        LOG(WARNING) << "Could not create the state snapshot /dev/shm/" << name << ": " << strerror(errno);
+        return false;
+    }
+
+    // After a restart the sequence goes on from where the last instance
+    // left it, readers mustn't see it go back.
+    uint32_t sequence = m_segment->sequence.load(std::memory_order_relaxed);
+    if (m_segment->magic != magic || m_segment->version != version)
+        sequence = 0;
+    m_segment->sequence.store(sequence | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_segment->magic = magic;
+    m_segment->version = version;
+    m_segment->state = {};
+    m_segment->sequence.store((sequence | 1) + 1, std::memory_order_release);
+
+    LOG(INFO) << "Publishing the state in /dev/shm/" << name;
+    return true;
+}
+
+bool Writer::enabled() const
+{
+    return m_segment;
+}
+
+State& Writer::state()
+{
+    return m_state;
+}
+
+void Writer::publish()
+{
+    if (!m_segment)
+        return;
+
+    size_t size = used_size(m_state);
+    if (size == used_size(m_published) && memcmp(&m_state, &m_published, size) == 0)
+        return;
+    memcpy(&m_published, &m_state, size);
+
+    // Seqlock: odd while writing, readers retry if it's odd or changed while
+    // they copied.
+    uint32_t sequence = m_segment->sequence.load(std::memory_order_relaxed);
+    m_segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&m_segment->state, &m_state, size);
+    m_segment->sequence.store(sequence + 2, std::memory_order_release);
+
+    // The only syscall, and only when someone is waiting for it.
+    if (m_segment->waiters.load(std::memory_order_seq_cst))
+        syscall(SYS_futex, &m_segment->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+Reader::~Reader()
+{
+    if (m_segment)
+        munmap(m_segment, sizeof(Segment));
+}
+
+bool Reader::open(const std::string& name)
+{
+    m_segment = map_segment(name, false);
+    if (m_segment && (m_segment->magic != magic || m_segment->version != version)) {
+        munmap(m_segment, sizeof(Segment));
+        m_segment = nullptr;
+    }
+    return m_segment;
+}
+
+uint32_t Reader::read(State& state) const
+{
+    for (;;) {
+        uint32_t before = m_segment->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        // The count may be torn, the sequence check below catches that.
+        uint32_t count = std::min<uint32_t>(m_segment->state.client_count, max_clients);
+        memcpy(&state, &m_segment->state, offsetof(State, clients) + count * sizeof(Client));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (m_segment->sequence.load(std::memory_order_relaxed) == before)
+            return before;
+    }
+}
+
+void Reader::wait(uint32_t sequence, std::chrono::milliseconds timeout) const
+{
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+    timespec ts { seconds.count(), std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - seconds).count() };
+
+    m_segment->waiters.fetch_add(1, std::memory_order_seq_cst);
+    // Returns right away if it changed in the meantime.
+    if (m_segment->sequence.load(std::memory_order_seq_cst) == sequence)
+        syscall(SYS_futex, &m_segment->sequence, FUTEX_WAIT, sequence, &ts, nullptr, 0);
+    m_segment->waiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// The window manager's state in a shared memory segment, for bars, pagers
+// and the like to read without asking the X server (or us) anything. The WM
+// side is a memory write per change; readers mmap the segment and copy the
+// state out under a seqlock, and can sleep on a futex until it changes. The
+// segment is /dev/shm/pluswm-<display>, children of the WM find its name in
+// $PLUSWM_SNAPSHOT.
+//
+// Only fixed size types in here, readers in other languages can map it the
+// same way. `version` changes with the layout.
+namespace Snapshot {
+
+static constexpr uint32_t magic = 0x534d5750; // "PWMS"
+static constexpr uint32_t version = 2;
+
+static constexpr size_t max_clients = 256;
+static constexpr size_t title_length = 128;
+
+struct Monitor {
+    int32_t x, y, width, height;
+    uint32_t tags; // bitmask of the viewed tags
+    uint32_t tag_count;
+    uint32_t layout; // `Layout` of the lowest viewed tag
+    uint32_t master_count;
+    float master_size;
+};
+
+enum ClientFlag : uint32_t {
+    Floating = 1 << 0,
+    Fullscreen = 1 << 1,
+    AlwaysOnTop = 1 << 2,
+    Urgent = 1 << 3,
+    Focused = 1 << 4,
+    Visible = 1 << 5,
+};
+
+struct Client {
+    uint64_t window;
+    int32_t x, y, width, height;
+    uint32_t tags;
+    uint32_t flags;
+    int32_t pid;                // -1 if unknown
+    char title[title_length];   // truncated, always terminated
+};
+
+// Counters for looking into the window manager's performance.
+struct Stats {
+    uint64_t layout_cache_hits;
+    uint64_t layout_cache_misses;
+};
+
+struct State {
+    uint64_t focused; // None if nothing is
+    Monitor monitor;
+    Stats stats;
+    uint32_t client_count;
+    Client clients[max_clients]; // newest first, `client_count` of them
+};
+
+struct Segment {
+    uint32_t magic;
+    uint32_t version;
+    // Odd while the state is being written. Also the futex word readers
+    // sleep on, and `waiters` says whether any do.
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> waiters;
+    State state;
+};
+
+// The publishing side, in the window manager.
+class Writer {
+public:
+    Writer() = default;
+    Writer(const Writer&) = delete;
+    Writer operator=(const Writer&) = delete;
+
+    ~Writer();
+
+    // Creates (or after a restart, takes over) the segment. Publishing stays
+    // disabled if that fails.
+    bool open(const std::string&);
+    bool enabled() const;
+
+    // To fill in, `publish()` copies it to the segment if it changed.
+    State& state();
+    void publish();
+
+private:
+    Segment* m_segment { nullptr };
+    State m_state {};
+    // What the segment holds, so unchanged state isn't written again.
+    State m_published {};
+};
+
+// For readers, mostly as an example of the protocol.
+class Reader {
+public:
+    Reader() = default;
+    Reader(const Reader&) = delete;
+    Reader operator=(const Reader&) = delete;
+
+    ~Reader();
+
+    bool open(const std::string&);
+
+    // A consistent copy of the state. Returns its sequence number, which only
+    // grows.
+    uint32_t read(State&) const;
+
+    // Sleeps until the state changes from the one with that sequence number,
+    // or the timeout runs out.
+    void wait(uint32_t, std::chrono::milliseconds) const;
+
+private:
+    Segment* m_segment { nullptr };
+};
+
+// The segment's name for an X display, e.g. "pluswm-:0".
+std::string segment_name(const char*);
+
+}
@@ -0,0 +1,96 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibTask.h>
+#include <algorithm>
+#include <exception>
+#include <glog/logging.h>
+#include <xcb/xcbext.h>
+
+void Task::promise_type::unhandled_exception()
+{
+    try {
+        std::rethrow_exception(std::current_exception());
+    } catch (const std::exception& e) {
+        LOG(FATAL) << "Uncaught exception in a coroutine: " << e.what();
+    } catch (...) {
+        LOG(FATAL) << "Uncaught exception in a coroutine";
+    }
+}
+
+Sleep::Sleep(EventLoop& loop, std::chrono::milliseconds duration)
+    : m_loop(loop)
+    , m_duration(duration)
+{
+}
+
+void Sleep::await_suspend(std::coroutine_handle<> handle)
+{
+    m_loop.add_timer(m_duration, [handle] { handle.resume(); });
+}
+
+ChildWaiters::Awaiter::Awaiter(ChildWaiters& waiters, pid_t pid)
+    : m_waiters(waiters)
+    , m_pid(pid)
+{
+}
+
+void ChildWaiters::Awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_waiters.m_waiters[m_pid] = { handle, &m_status };
+}
+
+ChildWaiters::Awaiter ChildWaiters::exit_of(pid_t pid)
+{
+    return { *this, pid };
+}
+
+bool ChildWaiters::notify(pid_t pid, int status)
+{
+    auto it = m_waiters.find(pid);
+    if (it == m_waiters.end())
+        return false;
+
+    Waiter waiter = it->second;
+    m_waiters.erase(it);
+
+    *waiter.status = status;
+    waiter.handle.resume();
+    return true;
+}
+
+ReplyWaiters::ReplyWaiters(xcb_connection_t* connection)
+    : m_connection(connection)
+{
+}
+
+bool ReplyWaiters::try_take(unsigned int sequence, void*& reply, xcb_generic_error_t*& error)
+{
+    return xcb_poll_for_reply(m_connection, sequence, &reply, &error);
+}
+
+void ReplyWaiters::poll()
+{
+    if (m_waiting.empty())
+        return;
+
+    // Resumed coroutines may well send requests and wait again, so pick out
+    // the ready ones first.
+    std::vector<std::coroutine_handle<>> ready;
+    auto still_waiting = std::remove_if(m_waiting.begin(), m_waiting.end(), [&](const Waiter& waiter) {
+        if (!try_take(waiter.sequence, *waiter.reply, *waiter.error))
+            return false;
+        ready.push_back(waiter.handle);
+        return true;
+    });
+    m_waiting.erase(still_waiting, m_waiting.end());
+
+    for (auto handle : ready)
+        handle.resume();
+}
+
+size_t ReplyWaiters::waiting() const
+{
+    return m_waiting.size();
+}
@@ -0,0 +1,144 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <LibEventLoop.h>
+#include <chrono>
+#include <coroutine>
+#include <cstdlib>
+#include <memory>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+#include <xcb/xcb.h>
+
+// A coroutine nobody waits for. It starts running right away, like a normal
+// call, and frees itself once it returns. Whatever it awaits has to resume it
+// from the event loop.
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception();
+    };
+};
+
+// `co_await Sleep(loop, ms)` resumes from a timer on the loop.
+class Sleep {
+public:
+    Sleep(EventLoop&, std::chrono::milliseconds);
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<>);
+    void await_resume() const { }
+
+private:
+    EventLoop& m_loop;
+    std::chrono::milliseconds m_duration;
+};
+
+// Coroutines waiting for a child process to exit, resumed by whoever reaps
+// children.
+class ChildWaiters {
+public:
+    class Awaiter {
+    public:
+        Awaiter(ChildWaiters&, pid_t);
+
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<>);
+        // The wait status, as from waitpid().
+        int await_resume() const { return m_status; }
+
+    private:
+        ChildWaiters& m_waiters;
+        pid_t m_pid;
+        int m_status { 0 };
+    };
+
+    // Has to be awaited before the event loop gets to reap the child.
+    Awaiter exit_of(pid_t);
+
+    // Resumes whoever waits for the child, returns false if nobody does.
+    bool notify(pid_t, int);
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        int* status;
+    };
+
+    std::unordered_map<pid_t, Waiter> m_waiters;
+};
+
+struct FreeDeleter {
+    void operator()(void* ptr) const { free(ptr); }
+};
+
+// Null if the request failed.
+template<typename Reply>
+using XcbReply = std::unique_ptr<Reply, FreeDeleter>;
+
+// Coroutines waiting for replies from the server. Nothing here reads from the
+// connection, `poll()` has to be called after whoever does (Xlib, through
+// XPending()) so the replies it came across are handed out.
+class ReplyWaiters {
+public:
+    explicit ReplyWaiters(xcb_connection_t*);
+    ReplyWaiters(const ReplyWaiters&) = delete;
+    ReplyWaiters operator=(const ReplyWaiters&) = delete;
+
+    template<typename Reply>
+    class Awaiter {
+    public:
+        Awaiter(ReplyWaiters& waiters, unsigned int sequence)
+            : m_waiters(waiters)
+            , m_sequence(sequence)
+        {
+        }
+
+        bool await_ready() { return m_waiters.try_take(m_sequence, m_reply, m_error); }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            m_waiters.m_waiting.push_back({ m_sequence, handle, &m_reply, &m_error });
+        }
+        XcbReply<Reply> await_resume()
+        {
+            free(m_error);
+            return XcbReply<Reply>(static_cast<Reply*>(m_reply));
+        }
+
+    private:
+        ReplyWaiters& m_waiters;
+        unsigned int m_sequence;
+        void* m_reply { nullptr };
+        xcb_generic_error_t* m_error { nullptr };
+    };
+
+    // `co_await waiters.reply<xcb_get_geometry_reply_t>(cookie.sequence)`
+    template<typename Reply>
+    Awaiter<Reply> reply(unsigned int sequence) { return { *this, sequence }; }
+
+    // Resumes everyone whose reply (or error) has arrived.
+    void poll();
+
+    size_t waiting() const;
+
+private:
+    struct Waiter {
+        unsigned int sequence;
+        std::coroutine_handle<> handle;
+        void** reply;
+        xcb_generic_error_t** error;
+    };
+
+    bool try_take(unsigned int, void*&, xcb_generic_error_t*&);
+
+    xcb_connection_t* m_connection;
+    std::vector<Waiter> m_waiting;
+};
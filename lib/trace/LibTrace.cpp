@@ -0,0 +1,154 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibTrace.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <glog/logging.h>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Trace {
+
+namespace {
+
+struct Record {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+// Written by its own thread only. `head` counts every span ever recorded,
+// the buffer holds the last `records.size()` of them.
+struct Buffer {
+    const char* thread_name;
+    pid_t tid;
+    std::vector<Record> records;
+    std::atomic<uint64_t> head { 0 };
+};
+
+std::string g_path;
+size_t g_capacity;
+
+// Buffers are never freed, a thread that exits leaves its spans behind for
+// the next `write()`.
+std::mutex g_buffers_lock;
+std::vector<std::unique_ptr<Buffer>> g_buffers;
+
+thread_local Buffer* t_buffer = nullptr;
+
+Buffer* buffer_for_thread(const char* name)
+{
+    if (t_buffer)
+        return t_buffer;
+
+    auto buffer = std::make_unique<Buffer>();
+    buffer->thread_name = name;
+    buffer->tid = syscall(SYS_gettid);
+    buffer->records.resize(g_capacity);
+
+    std::lock_guard lock(g_buffers_lock);
+    t_buffer = g_buffers.emplace_back(std::move(buffer)).get();
+    return t_buffer;
+}
+
+// Names come from our own string literals and X event names, none of which
+// need escaping beyond this.
+void write_escaped(FILE* file, const char* str)
+{
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', file);
+        fputc(*str, file);
+    }
+}
+
+}
+
+void start(const std::string& path, size_t capacity)
+{
+    g_path = path;
+    g_capacity = std::max<size_t>(capacity, 1);
+    buffer_for_thread("main");
+    g_enabled = true;
+
+    LOG(INFO) << "Tracing into buffers of " << g_capacity << " spans, written to " << g_path << " on SIGUSR1";
+}
+
+void register_thread(const char* name)
+{
+    if (enabled())
+        buffer_for_thread(name);
+}
+
+uint64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void record(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+    Buffer* buffer = buffer_for_thread("thread");
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    buffer->records[head % buffer->records.size()] = { name, start_ns, end_ns };
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+bool write()
+{
+    if (!enabled())
+        return false;
+
+    std::string tmp_path = g_path + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "we");
+    if (!file) {
+        LOG(ERROR) << "Could not open " << tmp_path << ": " << strerror(errno);
+        return false;
+    }
+
+    pid_t pid = getpid();
+    size_t spans = 0;
+    bool first = true;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+
+    std::lock_guard lock(g_buffers_lock);
+    for (const auto& buffer : g_buffers) {
+        fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"",
+            first ? "" : ",", pid, buffer->tid);
+        write_escaped(file, buffer->thread_name);
+        fputs("\"}}", file);
+        first = false;
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        size_t size = buffer->records.size();
+        for (uint64_t i = head > size ? head - size : 0; i < head; i++) {
+            const Record& record = buffer->records[i % size];
+            // Complete events, timestamps in microseconds.
+            fprintf(file, ",\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"", pid,
+                buffer->tid, record.start_ns / 1000.0, (record.end_ns - record.start_ns) / 1000.0);
+            write_escaped(file, record.name);
+            fputs("\"}", file);
+            spans++;
+        }
+    }
+
+    fputs("\n]}\n", file);
+    if (fclose(file) != 0 || rename(tmp_path.c_str(), g_path.c_str()) != 0) {
+        LOG(ERROR) << "Could not write " << g_path << ": " << strerror(errno);
+        return false;
+    }
+
+    LOG(INFO) << "Wrote " << spans << " spans to " << g_path;
+    return true;
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Spans of time spent in event handlers, X requests and round trips, written
+// out as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) on demand.
+// Off unless `Trace::start()` was called, a span then costs a load and a
+// branch.
+namespace Trace {
+
+// Records into a buffer of `capacity` spans per thread, the oldest ones
+// get overwritten. `path` is where `write()` puts the trace.
+void start(const std::string& path, size_t capacity);
+
+inline std::atomic<bool> g_enabled { false };
+
+inline bool enabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+// Gives the calling thread a name in the trace and allocates its buffer up
+// front. Threads that don't do this get one on their first span.
+void register_thread(const char*);
+
+// Names have to outlive the trace, string literals or the like.
+void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+uint64_t now_ns();
+
+// Writes everything recorded so far to the path given to `start()`. Spans of
+// other threads still being written may come out garbled, everything else is
+// intact.
+bool write();
+
+class Span {
+public:
+    explicit Span(const char* name)
+        : m_name(name)
+        , m_start(enabled() ? now_ns() : 0)
+    {
+    }
+
+    Span(const Span&) = delete;
+    Span operator=(const Span&) = delete;
+
+    ~Span()
+    {
+        if (m_start)
+            record(m_name, m_start, now_ns());
+    }
+
+private:
+    const char* m_name;
+    uint64_t m_start;
+};
+
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// Traces the rest of the enclosing scope.
+#define TRACE_SPAN(name) Trace::Span TRACE_CONCAT(trace_span_, __LINE__)(name)
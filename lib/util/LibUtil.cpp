@@ -3,9 +3,39 @@
  */
 
 #include <LibUtil.h>
+#include <csignal>
+#include <unistd.h>
 
 namespace Util {
 
+pid_t spawn(const char* command, int cgroup_procs)
+{
+    const char* cmdarg[] = { "/bin/sh", "-c", command, NULL };
+
+    pid_t child = fork();
+
+    if (child == 0) {
+        // The window manager blocks signals it reads through signalfd, don't
+        // pass that on.
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+        // "0" stands for the writing process. If that fails, running
+        // outside of the group still beats not running at all.
+        if (cgroup_procs >= 0) {
+            ssize_t written = write(cgroup_procs, "0", 1);
+            (void)written;
+        }
+
+        setsid();
+        execvp(cmdarg[0], (char**)cmdarg);
+        _exit(127);
+    }
+
+    return child;
+}
+
 std::string x_request_code_to_string(unsigned char request_code)
 {
     static const char* X_REQUEST_CODE_NAMES[] = {
@@ -135,7 +165,7 @@ std::string x_request_code_to_string(unsigned char request_code)
     return X_REQUEST_CODE_NAMES[request_code];
 }
 
-std::string x_event_code_to_string(const XEvent& ev)
+const char* x_event_type_name(int type)
 {
     static const char* X_EVENT_TYPE_NAMES[] = {
         "",
@@ -175,13 +205,22 @@ std::string x_event_code_to_string(const XEvent& ev)
         "MappingNotify",
         "GeneralEvent",
     };
-    if (ev.type < 2 || ev.type >= LASTEvent) {
+    if (type < 2 || type >= LASTEvent)
+        return nullptr;
+
+    return X_EVENT_TYPE_NAMES[type];
+}
+
+std::string x_event_code_to_string(const XEvent& ev)
+{
+    const char* name = x_event_type_name(ev.type);
+    if (!name) {
         std::ostringstream out;
         out << "Unknown (" << ev.type << ")";
         return out.str();
     }
 
-    return static_cast<std::string>(X_EVENT_TYPE_NAMES[ev.type]);
+    return name;
 }
 
 }
@@ -8,12 +8,20 @@
 #include <string>
 
 #include <X11/Xlib.h>
+#include <sys/types.h>
 
 namespace Util {
 
 std::string x_request_code_to_string(unsigned char);
 
+// Runs `command` through /bin/sh in a new session. Returns the child's pid,
+// or -1 if fork() failed. Given a cgroup's `cgroup.procs`, the child moves
+// itself in there first, so nothing it starts can end up outside of it.
+pid_t spawn(const char*, int cgroup_procs = -1);
+
 std::string x_event_code_to_string(const XEvent&);
+// Same, without allocating. nullptr for unknown types.
+const char* x_event_type_name(int);
 
 template<typename T>
 struct Size {
@@ -2,27 +2,165 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <LibBar.h>
 #include <LibClient.h>
+#include <LibConfig.h>
+#include <LibFrame.h>
+#include <LibSession.h>
+#include <LibTrace.h>
 #include <LibUtil.h>
 #include <LibWM.h>
 #include <X11/X.h>
 #include <X11/XKBlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/cursorfont.h>
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstring>
 #include <exception>
+#include <fcntl.h>
 #include <glog/logging.h>
+#include <string>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <unordered_set>
 #include <cassert>
 
 #include <config.h>
 
-inline unsigned int clean_mask(const unsigned int mask)
+// Holds the memfd with the session state across a restart.
+static constexpr const char* session_fd_env = "PLUSWM_SESSION_FD";
+static constexpr const char* trace_env = "PLUSWM_TRACE";
+// Set for everything we spawn, to the name of the state snapshot's segment.
+static constexpr const char* snapshot_env = "PLUSWM_SNAPSHOT";
+
+static Visual* find_visual(Display* display, VisualID id)
+{
+    Screen* screen = DefaultScreenOfDisplay(display);
+    for (int i = 0; i < screen->ndepths; i++) {
+        for (int j = 0; j < screen->depths[i].nvisuals; j++) {
+            if (screen->depths[i].visuals[j].visualid == id)
+                return &screen->depths[i].visuals[j];
+        }
+    }
+    return DefaultVisualOfScreen(screen);
+}
+
+// Runs on the worker thread.
+static SizeHints fetch_size_hints(Display* display, Window window)
+{
+    SizeHints hints {};
+    XSizeHints size;
+    long supplied;
+    if (!XGetWMNormalHints(display, window, &size, &supplied))
+        return hints;
+
+    auto clamp = [](int value) { return static_cast<int16_t>(std::clamp(value, 0, 0x7fff)); };
+
+    // Either of the base and minimum size stands in for the other.
+    if (size.flags & PBaseSize) {
+        hints.base_width = clamp(size.base_width);
+        hints.base_height = clamp(size.base_height);
+    } else if (size.flags & PMinSize) {
+        hints.base_width = clamp(size.min_width);
+        hints.base_height = clamp(size.min_height);
+    }
+    if (size.flags & PMinSize) {
+        hints.min_width = clamp(size.min_width);
+        hints.min_height = clamp(size.min_height);
+    } else if (size.flags & PBaseSize) {
+        hints.min_width = clamp(size.base_width);
+        hints.min_height = clamp(size.base_height);
+    }
+    if (size.flags & PMaxSize) {
+        hints.max_width = clamp(size.max_width);
+        hints.max_height = clamp(size.max_height);
+    }
+    if (size.flags & PResizeInc) {
+        hints.width_inc = clamp(size.width_inc);
+        hints.height_inc = clamp(size.height_inc);
+    }
+    if (size.flags & PAspect && size.min_aspect.x > 0 && size.max_aspect.y > 0) {
+        hints.min_aspect = static_cast<float>(size.min_aspect.y) / size.min_aspect.x;
+        hints.max_aspect = static_cast<float>(size.max_aspect.x) / size.max_aspect.y;
+    }
+    return hints;
+}
+
+// Runs on the worker thread.
+static std::string fetch_name(Display* display, Window window)
+{
+    std::string name;
+    char* text = nullptr;
+    if (XFetchName(display, window, &text) && text) {
+        name = text;
+        XFree(text);
+    }
+    return name;
+}
+
+// The process behind a window, and what freeze rules are matched against.
+struct ProcessProperties {
+    pid_t pid { -1 };
+    std::string cgroup;
+    std::string instance, class_name, title;
+};
+
+// Runs on the worker thread. The class and title are only fetched if asked
+// for, they're only needed to look up freeze rules.
+static ProcessProperties fetch_process(Display* display, Window window, Atom pid_atom, const std::string& hostname,
+    bool cgroups, bool class_and_title)
 {
-    return (mask & ~(LockMask) & (ShiftMask | ControlMask | Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask));
+    ProcessProperties process;
+
+    Atom type;
+    int format;
+    unsigned long count, remaining;
+    unsigned char* data = nullptr;
+    if (XGetWindowProperty(display, window, pid_atom, 0, 1, false, XA_CARDINAL, &type, &format, &count, &remaining,
+            &data) != Success || !data)
+        return process;
+
+    pid_t pid = count == 1 && format == 32 ? *reinterpret_cast<long*>(data) : -1;
+    XFree(data);
+
+    // The pid is whatever the client says, and only means anything on the
+    // machine it runs on. A client from elsewhere (`ssh -X`) or one that
+    // doesn't say where it runs would have some unrelated local process
+    // stopped or accounted to it.
+    XTextProperty machine {};
+    bool local = XGetWMClientMachine(display, window, &machine) && machine.value
+        && hostname == reinterpret_cast<const char*>(machine.value);
+    XFree(machine.value);
+    if (!local || pid <= 0)
+        return process;
+
+    process.pid = pid;
+    if (cgroups)
+        process.cgroup = Cgroups::cgroup_of(pid);
+
+    if (class_and_title) {
+        XClassHint hint {};
+        if (XGetClassHint(display, window, &hint)) {
+            process.instance = hint.res_name ? hint.res_name : "";
+            process.class_name = hint.res_class ? hint.res_class : "";
+            XFree(hint.res_name);
+            XFree(hint.res_class);
+        }
+        process.title = fetch_name(display, window);
+    }
+    return process;
 }
 
+static constexpr unsigned int all_modifiers = ShiftMask | ControlMask | Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask;
+
 WinMan& WinMan::get()
 {
     static WinMan instance(XOpenDisplay(nullptr));
@@ -32,7 +170,20 @@ WinMan& WinMan::get()
 WinMan::WinMan(Display* display)
     : m_display(CHECK_NOTNULL(display))
     , m_root_window(DefaultRootWindow(m_display))
+    , m_xcb(XGetXCBConnection(m_display))
+    , m_replies(m_xcb)
+    , m_requests(1024)
+    , m_layouts(Config::layout_cache_size)
 {
+    // Neither spawned programs nor the instance we re-exec into on restart
+    // should inherit our X connection.
+    fcntl(ConnectionNumber(m_display), F_SETFD, FD_CLOEXEC);
+
+    // To tell local clients from remote ones, see `manage()`.
+    char hostname[HOST_NAME_MAX + 1] = {};
+    if (gethostname(hostname, sizeof(hostname) - 1) == 0)
+        m_hostname = hostname;
+
     // init atoms
     m_wmatom[WMAtom::WMProtocols] = XInternAtom(m_display, "WM_PROTOCOLS", false);
     m_wmatom[WMAtom::WMDelete] = XInternAtom(m_display, "WM_DELETE_WINDOW", false);
@@ -42,6 +193,7 @@ WinMan::WinMan(Display* display)
     m_netatom[NetAtom::NetState] = XInternAtom(m_display, "_NET_WM_STATE", false);
     m_netatom[NetAtom::NetFullscreen] = XInternAtom(m_display, "_NET_WM_STATE_FULLSCREEN", false);
     m_netatom[NetAtom::NetName] = XInternAtom(m_display, "_NET_WM_NAME", false);
+    m_netatom[NetAtom::NetWMPid] = XInternAtom(m_display, "_NET_WM_PID", false);
     // init cursor map
     m_cursors[Cursors::LeftPointing] = XCreateFontCursor(m_display, XC_left_ptr);
 	m_cursors[Cursors::Hand] = XCreateFontCursor(m_display, XC_hand2);
@@ -52,15 +204,22 @@ WinMan::WinMan(Display* display)
     m_monitor.size = Size<int>{DisplayWidth(m_display, m_monitor.screen),
         DisplayHeight(m_display, m_monitor.screen)};
 
+    // init settings, the runtime config file takes precedence over config.h
+    m_config_path = Settings::default_path();
+    m_settings = Settings::load(m_config_path);
+    if (!m_settings)
+        m_settings = Settings::defaults();
+    m_config_watcher = std::make_unique<ConfigWatcher>(m_config_path);
+    m_monitor.master_size = m_settings->master_size;
+    m_monitor.layouts.assign(Config::tags.size(), Config::default_layout);
+
 	// Color stuff
 	m_colormap = XCreateColormap(m_display, m_root_window, DefaultVisual(m_display, m_monitor.screen), AllocNone);
 
-	for (const auto& [color, value] : Config::colors) {
-		XColor xcolor;
-		XParseColor(m_display, m_colormap, value, &xcolor);
-		XAllocColor(m_display, m_colormap, &xcolor);
-		m_colors[color] = xcolor;
-	}
+    alloc_colors();
+
+    for (const auto& scratchpad : Config::scratchpads)
+        m_scratchpads.push_back({ &scratchpad });
 }
 
 WinMan::~WinMan()
@@ -92,7 +251,7 @@ Atom WinMan::net_atom(NetAtom atom)
     return m_netatom[atom];
 }
 
-Client WinMan::window_client_map_at(Window window) const
+Client& WinMan::window_client_map_at(Window window)
 {
 	try {
 		return m_window_to_client_map.at(window);
@@ -103,7 +262,7 @@ Client WinMan::window_client_map_at(Window window) const
 		LOG(FATAL) << e.what();
 	}
 
-	return Client();
+	__builtin_unreachable();
 }
 
 Cursor WinMan::cursor(Cursors cursor)
@@ -116,258 +275,2026 @@ Monitor WinMan::monitor() const
     return m_monitor;
 }
 
-Client WinMan::currently_focused() const
+const Settings& WinMan::settings() const
 {
-    int n;
-    Window currently_focused;
-	// NOTE: The function below apparently stores the window ID '1' in the above
-	// variable, which doesn't exist. This in turn makes the 'window_client_map_at'
-	// function to throw an 'out_of_range' exception.
-	// FIXME: We should refocus to another window (method of determining that window
-	// to be decided) when the currently focusd window has been killed and there is
-	// NO currently focused window.
-    XGetInputFocus(m_display, &currently_focused, &n);
+    return *m_settings;
+}
 
-	// This is what breaks.
-    return window_client_map_at(currently_focused);
+GeometryStore& WinMan::geometry()
+{
+    return m_geometry;
 }
 
-int WinMan::on_wm_detected(Display*, XErrorEvent* err)
+Client* WinMan::currently_focused()
 {
-    CHECK_EQ(static_cast<int>(err->error_code), BadAccess);
-    m_wm_detected = true;
+    auto it = m_window_to_client_map.find(m_focused);
+    return it == m_window_to_client_map.end() ? nullptr : &it->second;
+}
 
-    return 0;
+void WinMan::focus_changed(Window window)
+{
+    m_focused = window;
+
+    if (!m_window_to_client_map.contains(window))
+        return;
+
+    // It got the attention it asked for.
+    Client& client = m_window_to_client_map[window];
+    client.set_urgent(false);
+
+    // Cycling through the history leaves it alone until it's done.
+    if (!m_focus_cycle.active)
+        m_geometry.focused(client.handle());
 }
 
-int WinMan::on_x_error(Display* display, XErrorEvent* err)
+void WinMan::view_tags(unsigned int tags)
 {
-    constexpr int MAX_ERROR_TEXT_LENGTH = 1024;
-    char error_text[MAX_ERROR_TEXT_LENGTH];
-    XGetErrorText(display, err->error_code, error_text, sizeof(error_text));
+    tags &= (1 << Config::tags.size()) - 1;
+    if (!tags || tags == m_monitor.tags)
+        return;
 
-    LOG(FATAL) << "Recieved X error:\n"
-               << "\tRequest: " << int(err->request_code) << " - "
-               << Util::x_request_code_to_string(err->request_code) << "\n"
-               << "\tError code: " << int(err->error_code) << " - " << error_text
-               << "\n"
-               << "\tResource ID: " << err->resourceid;
+    m_monitor.tags = tags;
+    tile();
 
-    return 0;
+    if (!m_window_to_client_map.contains(m_focused) || !m_visible[m_window_to_client_map[m_focused].handle()])
+        focus_most_recent();
 }
 
-void WinMan::run()
+void WinMan::toggle_tags(unsigned int tags)
 {
-    XSetErrorHandler(&WinMan::on_wm_detected);
+    unsigned int new_tags = (m_monitor.tags ^ tags) & ((1 << Config::tags.size()) - 1);
+    if (!new_tags)
+        return;
 
-    unsigned int mask = SubstructureNotifyMask | SubstructureRedirectMask | ButtonPressMask;
-    XSelectInput(m_display, m_root_window, mask);
+    m_monitor.tags = new_tags;
+    tile();
 
-    XSetWindowAttributes wa;
-    wa.cursor = this->cursor(Cursors::LeftPointing);
-    XChangeWindowAttributes(m_display, m_root_window, CWCursor, &wa);
+    if (!m_window_to_client_map.contains(m_focused) || !m_visible[m_window_to_client_map[m_focused].handle()])
+        focus_most_recent();
+}
 
-    XSync(m_display, false);
+void WinMan::move_focused_to_tags(unsigned int tags)
+{
+    tags &= (1 << Config::tags.size()) - 1;
+    if (!tags || !m_window_to_client_map.contains(m_focused))
+        return;
 
-    if (m_wm_detected)
-        LOG(FATAL) << "Detected another window manager running on display "
-                   << XDisplayString(m_display);
+    m_window_to_client_map[m_focused].set_tags(tags);
+    tile();
+}
 
-    grab_keys();
+void WinMan::cycle_layout(int direction)
+{
+    int count = static_cast<int>(Layout::Count);
+    Layout& layout = current_layout();
+    layout = static_cast<Layout>(((static_cast<int>(layout) + direction) % count + count) % count);
 
-    // Set the error handler for normal execution.
-    XSetErrorHandler(&WinMan::on_x_error);
+    LOG(INFO) << "Layout " << layout_symbol(layout) << " on tag " << __builtin_ctz(m_monitor.tags) + 1;
+    tile();
+}
 
-    // Main event loop.
-    for (;;) {
-        XEvent e;
-        XNextEvent(m_display, &e);
+void WinMan::toggle_floating()
+{
+    if (!m_window_to_client_map.contains(m_focused))
+        return;
 
-        LOG(INFO) << "Recieved event: " << Util::x_event_code_to_string(e);
+    Client& client = m_window_to_client_map[m_focused];
+    client.set_floating(!client.is_floating());
 
-        switch (e.type) {
-        case CreateNotify:
-            on_CreateNotify(e.xcreatewindow);
-            break;
-        case DestroyNotify:
-            on_DestroyNotify(e.xdestroywindow);
-            break;
-        case MapRequest:
-            on_MapRequest(e.xmaprequest);
-            break;
-        case MapNotify:
-            on_MapNotify(e.xmap);
-            break;
-        case UnmapNotify:
-            on_UnmapNotify(e.xunmap);
-            break;
-        case ConfigureRequest:
-            on_ConfigureRequest(e.xconfigurerequest);
-            break;
-        case ConfigureNotify:
-            on_ConfigureNotify(e.xconfigure);
-            break;
-        case KeyPress:
-            on_KeyPress(e.xkey);
-            break;
-        case KeyRelease:
-            on_KeyRelease(e.xkey);
-            break;
-        case EnterNotify:
-            on_EnterNotify(e.xcrossing);
-            break;
-        case ButtonPress:
-            on_ButtonPress(e.xbutton);
-            break;
-		case MotionNotify:
-			on_MotionNotify(e.xmotion);
-			break;
-        default:
-            LOG(WARNING) << "[!!!] Non-implemented event " << Util::x_event_code_to_string(e) << " (" << e.type << ")";
-            break;
-        }
+    if (client.is_floating() && m_frame_pool)
+        frame(client);
+    else if (!client.is_floating() && client.is_framed())
+        unframe(client);
+
+    tile();
+}
+
+void WinMan::toggle_overview()
+{
+    if (!m_overview) {
+        LOG(INFO) << "The overview is disabled";
+        return;
+    }
+
+    if (m_overview->is_open()) {
+        m_overview->close();
+        return;
     }
+
+    // Hidden scratchpads are unmapped, nothing to show for them.
+    std::vector<Window> windows;
+    for (Window window : m_stack) {
+        if (m_window_to_client_map[window].tags())
+            windows.push_back(window);
+    }
+    m_overview->open(windows, m_focused);
 }
 
-void WinMan::grab_keys()
+void WinMan::overview_key(KeySym key, unsigned int state)
+{
+    switch (key) {
+    case XK_Escape:
+        m_overview->close();
+        break;
+    case XK_Return:
+    case XK_KP_Enter:
+        overview_pick(m_overview->selected());
+        break;
+    case XK_Tab:
+        m_overview->move_selection(state & ShiftMask ? -1 : 1);
+        break;
+    case XK_Right:
+    case XK_Down:
+        m_overview->move_selection(1);
+        break;
+    case XK_Left:
+    case XK_Up:
+        m_overview->move_selection(-1);
+        break;
+    default:
+        break;
+    }
+}
+
+void WinMan::overview_pick(Window window)
+{
+    m_overview->close();
+    if (!m_window_to_client_map.contains(window))
+        return;
+
+    Client& client = m_window_to_client_map[window];
+    if (!(client.tags() & m_monitor.tags))
+        view_tags(client.tags());
+
+    if (m_focused != window) {
+        if (m_window_to_client_map.contains(m_focused))
+            m_window_to_client_map[m_focused].unfocus();
+        client.focus();
+    }
+    client.raise_to_top();
+    restack();
+    set_crossing_barrier();
+}
+
+void WinMan::toggle_scratchpad(const char* name)
 {
-    XUngrabKey(m_display, AnyKey, AnyModifier, m_root_window);
+    auto slot = std::find_if(m_scratchpads.begin(), m_scratchpads.end(),
+        [name](const ScratchpadSlot& slot) { return !strcmp(slot.config->name, name); });
+    if (slot == m_scratchpads.end()) {
+        LOG(WARNING) << "No scratchpad named `" << name << "`";
+        return;
+    }
 
-    KeyCode keycode;
+    if (slot->window == None) {
+        LOG(INFO) << "Scratchpad `" << name << "` has no window yet";
+        return;
+    }
 
-    for (unsigned int i = 0; i < Config::keybinds.size(); i++) {
-        if ((keycode = XKeysymToKeycode(m_display, Config::keybinds[i].keysym()))) {
-            XGrabKey(m_display, keycode, Config::keybinds[i].modmask(), m_root_window, true, GrabModeAsync, GrabModeAsync);
+    Client& client = m_window_to_client_map[slot->window];
+
+    if (slot->visible && (client.tags() & m_monitor.tags)) {
+        client.unmap();
+        client.set_tags(0);
+        slot->visible = false;
+        if (m_focused == slot->window) {
+            client.unfocus();
+            m_focused = None;
         }
+        return;
     }
+
+    // Either hidden, or still shown on tags that aren't being viewed.
+    client.set_tags(m_monitor.tags);
+    client.move({ (m_monitor.size.width - client.size().width) / 2,
+        (m_monitor.size.height - client.size().height) / 2 });
+    if (!slot->visible)
+        client.map();
+    client.raise_to_top();
+
+    if (m_focused != slot->window && m_window_to_client_map.contains(m_focused))
+        m_window_to_client_map[m_focused].unfocus();
+    client.focus();
+    slot->visible = true;
 }
 
-void WinMan::on_CreateNotify(const XCreateWindowEvent&)
+void WinMan::spawn_scratchpad(ScratchpadSlot& slot)
 {
-    for (unsigned long i = 0; i < m_stack.size(); i++) {
-        LOG(INFO) << "STACK :: Position " << i << " = " << m_stack[i].window();
+    if (slot.pid > 0 || slot.window != None)
+        return;
+
+    slot.pid = spawn(slot.config->command);
+    if (slot.pid < 0) {
+        LOG(WARNING) << "Could not start scratchpad `" << slot.config->name << "`: " << strerror(errno);
+        slot.failures++;
+        schedule_scratchpad_respawn(slot);
+        return;
     }
+
+    LOG(INFO) << "Started scratchpad `" << slot.config->name << "` (pid " << slot.pid << ")";
 }
-void WinMan::on_DestroyNotify(const XDestroyWindowEvent& e)
+
+Task WinMan::schedule_scratchpad_respawn(ScratchpadSlot& slot)
 {
-    LOG(INFO) << "Destoryed window " << e.window;
+    if (slot.respawn_pending)
+        co_return;
+    slot.respawn_pending = true;
+
+    // Back off when the command keeps dying before it gets to map a window,
+    // rather than forking it in a loop.
+    unsigned int delay = slot.failures ? std::min(30000u, 500u << std::min(slot.failures, 6u)) : 0;
+    co_await Sleep(m_loop, std::chrono::milliseconds(delay));
+
+    slot.respawn_pending = false;
+    spawn_scratchpad(slot);
 }
 
-void WinMan::on_MapRequest(const XMapRequestEvent& e)
+bool WinMan::scratchpad_waiting() const
 {
-    LOG(INFO) << "Created window " << e.window;
+    return std::any_of(m_scratchpads.begin(), m_scratchpads.end(),
+        [](const ScratchpadSlot& slot) { return slot.pid > 0 && slot.window == None; });
+}
 
-    Client client { m_display, e.window };
+bool WinMan::capture_scratchpad(const Client& new_client, const char* instance, const char* win_class)
+{
+    auto matches = [](const char* pattern, const char* value) {
+        return !pattern || (value && !strcmp(pattern, value));
+    };
+
+    ScratchpadSlot* slot = nullptr;
+    for (auto& candidate : m_scratchpads) {
+        if (candidate.pid > 0 && candidate.window == None && matches(candidate.config->win_class, win_class)
+            && matches(candidate.config->win_instance, instance)) {
+            slot = &candidate;
+            break;
+        }
+    }
 
-    // insert the window into the stack
-    m_stack.insert(m_stack.begin(), client);
-    // insert into the map
+    if (!slot)
+        return false;
 
-    // FIXME: Use the [] operator.
-    m_window_to_client_map.emplace(e.window, client);
+    // Managed like any other floating window, except that it stays unmapped
+    // and on no tags until it's toggled.
+    Window window = new_client.window();
+    Client hidden = new_client;
+    hidden.set_tags(0);
+    hidden.set_floating(true);
+    manage(hidden);
 
-    // Get the XEnterWindow and XLeaveWindow events to manage focus
-    XSelectInput(m_display, e.window, EnterWindowMask | LeaveWindowMask);
+    Client& client = m_window_to_client_map[window];
+    client.resize({ static_cast<int>(m_monitor.size.width * slot->config->width),
+        static_cast<int>(m_monitor.size.height * slot->config->height) });
 
-	// Set window border
-	XSetWindowBorderWidth(m_display, e.window, Config::border_width_in_px);
-	XSetWindowBorder(m_display, e.window, m_colors[Colors::WindowBorderActive].pixel);
+    slot->window = window;
+    slot->failures = 0;
 
-	client.grab_input();
+    LOG(INFO) << "Scratchpad `" << slot->config->name << "` is ready (window " << window << ")";
+    return true;
+}
 
-    tile();
+pid_t WinMan::spawn(const char* command)
+{
+    CgroupLimits limits { Config::cgroup_app_cpu_weight, 0, Config::cgroup_app_memory_high,
+        Config::cgroup_app_memory_max };
+    int cgroup_procs = m_cgroups.open_scope(command, limits);
+    pid_t pid = Util::spawn(command, cgroup_procs);
+    if (cgroup_procs >= 0)
+        close(cgroup_procs);
+    return pid;
+}
 
-    client.map();
+Task WinMan::watch_child(pid_t pid, std::string command)
+{
+    int status = co_await m_children.exit_of(pid);
 
-    client.focus();
+    if (WIFEXITED(status) && WEXITSTATUS(status) != 0)
+        LOG(WARNING) << "`" << command << "` exited with status " << WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        LOG(WARNING) << "`" << command << "` was killed by signal " << WTERMSIG(status);
 }
 
-void WinMan::on_MapNotify(const XMapEvent& e)
+void WinMan::on_signals()
 {
-    LOG(INFO) << "Mapped window " << e.window;
+    bool child_exited = false;
+    signalfd_siginfo info;
+    while (read(m_signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGUSR1) {
+            Trace::write();
+        } else if (info.ssi_signo == SIGCHLD) {
+            child_exited = true;
+        } else {
+            LOG(INFO) << "Exiting on signal " << info.ssi_signo;
+            thaw_all();
+            exit(EXIT_SUCCESS);
+        }
+    }
+
+    if (child_exited)
+        reap_children();
 }
 
-void WinMan::on_UnmapNotify(const XUnmapEvent& e)
+void WinMan::reap_children()
 {
-    if (!m_window_to_client_map.contains(e.window)) {
-        LOG(INFO) << "Ignore UnmapNotify for non-client window " << e.window;
+    // Signals coalesce, so one read can stand for any number of children.
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if (m_children.notify(pid, status))
+            continue;
+
+        for (auto& slot : m_scratchpads) {
+            if (slot.pid != pid)
+                continue;
+
+            LOG(INFO) << "Scratchpad `" << slot.config->name << "` exited with status " << status;
+            slot.pid = -1;
+
+            // Otherwise it's restarted once its window is gone.
+            if (slot.window == None) {
+                slot.failures++;
+                schedule_scratchpad_respawn(slot);
+            }
+        }
+    }
+}
+
+void WinMan::frame(Client& client)
+{
+    if (client.is_framed())
         return;
+
+    Frame frame = m_frame_pool->acquire(client.visual(), client.depth());
+
+    // The frame takes over the border, the title area is just filled in.
+    XSetWindowBorderWidth(m_display, client.window(), 0);
+    XSetWindowBorderWidth(m_display, frame.window, m_settings->border_width_in_px);
+    XSetWindowBorder(m_display, frame.window, m_colors[Colors::WindowBorderActive].pixel);
+    XSetWindowBackground(m_display, frame.window, m_colors[Colors::WindowBorderActive].pixel);
+    XClearWindow(m_display, frame.window);
+
+    client.reparent_into(frame, Config::frame_title_height_in_px);
+
+    // Top the pool back up once we're idle, instead of creating windows
+    // while a client waits to be shown.
+    if (m_frame_pool->needs_refill() && !m_frame_refill_timer) {
+        m_frame_refill_timer = m_loop.add_timer(std::chrono::milliseconds(0), [this] {
+            m_frame_refill_timer = 0;
+            m_frame_pool->refill();
+        });
     }
+}
 
-    auto to_delete = std::find(m_stack.begin(), m_stack.end(), m_window_to_client_map[e.window]);
-    m_stack.erase(to_delete);
+void WinMan::unframe(Client& client)
+{
+    if (!client.is_framed())
+        return;
 
-    m_window_to_client_map.erase(e.window);
+    Frame frame = client.unparent();
+    XSetWindowBorderWidth(m_display, client.window(), m_settings->border_width_in_px);
+    m_frame_pool->release(frame);
+}
 
-    LOG(INFO) << "Unmapped window " << e.window;
+int WinMan::on_wm_detected(Display*, XErrorEvent* err)
+{
+    CHECK_EQ(static_cast<int>(err->error_code), BadAccess);
+    m_wm_detected = true;
 
-    tile();
+    return 0;
 }
 
-void WinMan::on_ConfigureRequest(const XConfigureRequestEvent& e)
+int WinMan::on_x_error(Display* display, XErrorEvent* err)
 {
-    // unsigned int value_mask;
-    XWindowChanges changes;
-    changes.x = e.x;
-    changes.y = e.y;
-    changes.width = e.width;
-    changes.height = e.height;
-    changes.border_width = Config::border_width_in_px;
-    changes.sibling = e.above;
-    changes.stack_mode = e.detail;
+    WinMan& wm = get();
+
+    // The handler is shared by all connections. The worker's requests are
+    // about windows that may well be gone by the time it gets to them.
+    if (display != wm.m_display)
+        return 0;
+
+    // Errors come back long after the request was sent, by then the window
+    // may be gone for reasons that are nobody's fault. The request log says
+    // what we were doing at the time.
+    const RequestLog::Entry* entry = wm.m_requests.find(err->serial);
+    const char* operation = entry && entry->operation ? entry->operation : "unknown";
+
+    if (wm.m_overview && wm.m_overview->owns_error(*err)) {
+        LOG(INFO) << "Thumbnail resource " << err->resourceid << " went away with its window during " << operation;
+        return 0;
+    }
+    bool names_window = err->error_code == BadWindow || err->error_code == BadDrawable;
+    Window window = names_window ? err->resourceid : entry ? entry->window : None;
+
+    switch (classify_x_error(*err)) {
+    case XErrorKind::WindowGone:
+        LOG(INFO) << "Window " << window << " went away during " << operation << " ("
+                  << Util::x_request_code_to_string(err->request_code) << ")";
+        wm.m_gone_windows.push_back(window);
+        return 0;
+    case XErrorKind::Race:
+        LOG(WARNING) << "Window " << window << " changed under " << operation << " ("
+                     << Util::x_request_code_to_string(err->request_code) << "), ignored";
+        return 0;
+    case XErrorKind::Bug:
+        break;
+    }
+
+    constexpr int MAX_ERROR_TEXT_LENGTH = 1024;
+    char error_text[MAX_ERROR_TEXT_LENGTH];
+    XGetErrorText(display, err->error_code, error_text, sizeof(error_text));
 
-    // Grant the request.
-    XConfigureWindow(m_display, e.window, e.value_mask, &changes);
-    LOG(INFO) << "Resize window  " << e.window << " to " << Size<unsigned int>(e.width, e.height);
+    LOG(FATAL) << "Recieved X error:\n"
+               << "\tRequest: " << int(err->request_code) << " - "
+               << Util::x_request_code_to_string(err->request_code) << "\n"
+               << "\tError code: " << int(err->error_code) << " - " << error_text
+               << "\n"
+               << "\tResource ID: " << err->resourceid << "\n"
+               << "\tDuring: " << operation << " on window " << window;
+
+    return 0;
 }
 
-void WinMan::on_ConfigureNotify(const XConfigureEvent& e)
+void WinMan::track(Window window, const char* operation)
 {
-    LOG(INFO) << "Configured window " << e.window;
+    m_requests.mark(NextRequest(m_display), window, operation);
 }
 
-void WinMan::on_KeyPress(const XKeyPressedEvent& e)
+void WinMan::drop_gone_clients()
 {
-    KeySym key = XkbKeycodeToKeysym(m_display, e.keycode, 0, 0);
+    TRACE_SPAN("WinMan::drop_gone_clients");
+
+    if (m_gone_windows.empty())
+        return;
 
-    for (unsigned long i = 0; i < Config::keybinds.size(); i++) {
-        if (key == Config::keybinds[i].keysym()
-            && clean_mask(Config::keybinds[i].modmask()) == clean_mask(e.state)) {
-            Config::keybinds[i].execute();
+    // Dropping them sends requests, which may well fail the same way.
+    std::vector<Window> gone;
+    gone.swap(m_gone_windows);
+
+    bool dropped = false;
+    for (Window window : gone) {
+        // The error may name the frame rather than the client's own window.
+        auto it = m_window_to_client_map.find(window);
+        if (it == m_window_to_client_map.end()) {
+            it = std::find_if(m_window_to_client_map.begin(), m_window_to_client_map.end(),
+                [window](const auto& pair) { return pair.second.outer_window() == window; });
         }
+        if (it == m_window_to_client_map.end())
+            continue;
+
+        LOG(INFO) << "Dropping client " << it->first << ", its window is gone";
+        unmanage(it->first);
+        dropped = true;
+    }
+
+    if (dropped) {
+        tile();
+        if (m_focused == None)
+            focus_most_recent();
     }
 }
 
-void WinMan::on_KeyRelease(const XKeyReleasedEvent&)
+void WinMan::run()
 {
+    XSetErrorHandler(&WinMan::on_wm_detected);
+
+    // When restarting, the server might not have noticed that the previous
+    // instance's connection is gone yet, so give it a moment.
+    const bool restarting = getenv(session_fd_env) != nullptr;
+
+    for (int attempt = 0;; attempt++) {
+        m_wm_detected = false;
+
+        unsigned int mask = SubstructureNotifyMask | SubstructureRedirectMask | ButtonPressMask | PropertyChangeMask;
+        XSelectInput(m_display, m_root_window, mask);
+        XSync(m_display, false);
+
+        if (!m_wm_detected)
+            break;
+
+        if (!restarting || attempt >= 50)
+            LOG(FATAL) << "Detected another window manager running on display "
+                       << XDisplayString(m_display);
+        usleep(2000);
+    }
+
+    XSetWindowAttributes wa;
+    wa.cursor = this->cursor(Cursors::LeftPointing);
+    XChangeWindowAttributes(m_display, m_root_window, CWCursor, &wa);
+
+    int xkb_opcode, xkb_error_base, xkb_major = XkbMajorVersion, xkb_minor = XkbMinorVersion;
+    if (XkbQueryExtension(m_display, &xkb_opcode, &m_xkb_event_base, &xkb_error_base, &xkb_major, &xkb_minor))
+        XkbSelectEvents(m_display, XkbUseCoreKbd, XkbNewKeyboardNotifyMask, XkbNewKeyboardNotifyMask);
+    else
+        m_xkb_event_base = -1;
+
+    update_keymap();
+
+    // Set the error handler for normal execution.
+    XSetErrorHandler(&WinMan::on_x_error);
+
+    // Processes we stopped stay stopped when we go away, whichever way that
+    // is, unless they're resumed first.
+    XSetIOErrorHandler(&WinMan::on_x_io_error);
+    google::InstallFailureFunction(&WinMan::on_fatal);
+
+    // Children are reaped through a signalfd rather than a signal handler,
+    // which makes it just another fd to poll.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGHUP);
+
+    // Tracing is for looking into latency and off unless asked for, SIGUSR1
+    // writes out what was recorded so far.
+    if (const char* path = getenv(trace_env)) {
+        Trace::start(path, Config::trace_buffer_spans);
+        sigaddset(&mask, SIGUSR1);
+    }
+    // Before starting any thread, they all have to block it.
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    m_signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    PCHECK(m_signal_fd >= 0) << "signalfd() failed";
+
+    // Before anything is spawned, so nothing is left behind in our group.
+    CgroupLimits wm_limits { Config::cgroup_wm_cpu_weight, Config::cgroup_wm_memory_low, 0, 0 };
+    if (Config::spawn_in_cgroups && m_cgroups.init(wm_limits))
+        update_cgroups();
+
+    if (Config::publish_snapshot) {
+        std::string name = Snapshot::segment_name(getenv("DISPLAY"));
+        if (m_snapshot.open(name))
+            setenv(snapshot_env, name.c_str(), 1);
+    }
+
+    m_worker = std::make_unique<Worker>();
+    // Finished jobs make room for the property fetches that didn't fit.
+    m_loop.watch_fd(m_worker->fd(), [this] {
+        m_worker->drain();
+        fetch_properties();
+    });
+
+    if (Config::show_bar) {
+        std::vector<std::string> tag_names(Config::tags.begin(), Config::tags.end());
+        m_bar = std::make_unique<Bar>(m_display, m_root_window, Position<int> { 0, 0 }, m_monitor.size.width,
+            Config::bar_font, tag_names);
+        m_bar->set_colors({ m_colors[Colors::BarForeground].pixel, m_colors[Colors::BarBackground].pixel,
+            m_colors[Colors::BarSelectedForeground].pixel, m_colors[Colors::BarSelectedBackground].pixel });
+        update_status();
+    }
+
+    if (Config::floating_frames)
+        m_frame_pool = std::make_unique<FramePool>(m_display, m_root_window, Config::frame_pool_size);
+
+    // Before adopting, so those windows get thumbnails too.
+    if (Config::overview) {
+        m_overview = std::make_unique<Overview>(m_display, m_root_window, m_monitor.size,
+            Config::overview_thumbnail_size_in_px);
+        if (m_overview->enabled())
+            m_overview->set_colors(m_colors[Colors::BarBackground], m_colors[Colors::WindowBorderActive]);
+        else
+            m_overview.reset();
+    }
+
+    adopt_windows();
+
+    for (auto& slot : m_scratchpads)
+        spawn_scratchpad(slot);
+
+    m_loop.watch_fd(ConnectionNumber(m_display), [this] { process_x_events(); });
+    m_loop.watch_fd(m_signal_fd, [this] { on_signals(); });
+    // Children of the previous instance may have exited during the restart.
+    reap_children();
+    if (m_config_watcher->fd() >= 0)
+        m_loop.watch_fd(m_config_watcher->fd(), [this] { reload_config(); });
+
+    // Main event loop.
+    for (;;) {
+        // Xlib may already have read events into its queue while handling
+        // replies, and those would never wake up poll().
+        process_x_events();
+        {
+            TRACE_SPAN("ReplyWaiters::poll");
+            m_replies.poll();
+        }
+        drop_gone_clients();
+        fetch_properties();
+        if (m_overview)
+            m_overview->update();
+        update_bar();
+        publish_snapshot();
+        {
+            TRACE_SPAN("XFlush");
+            XFlush(m_display);
+        }
+        TRACE_SPAN("EventLoop::run_once");
+        m_loop.run_once();
+    }
 }
 
-void WinMan::on_EnterNotify(const XEnterWindowEvent& e)
+void WinMan::set_argv(char** argv)
 {
-    // FIXME: Use the [] operator.
-	Client& client = m_window_to_client_map.at(e.window);
-	if (currently_focused() != client) {
-		currently_focused().unfocus();
-		client.focus();
-	}
+    m_argv = argv;
 }
 
-void WinMan::on_ButtonPress(const XButtonPressedEvent&)
+void WinMan::restart()
 {
+    TRACE_SPAN("WinMan::restart");
+
+    // The next instance doesn't know which processes we stopped.
+    thaw_all();
+
+    SessionState session;
+    session.master_size = m_monitor.master_size;
+    session.selected_tags = m_monitor.tags;
+    session.layouts.assign(m_monitor.layouts.begin(), m_monitor.layouts.end());
+
+    int revert;
+    XGetInputFocus(m_display, &session.focused, &revert);
+
+    session.clients.reserve(m_stack.size());
+    for (Window window : m_stack)
+        session.clients.push_back(m_window_to_client_map[window].state());
 
+    for (const auto& slot : m_scratchpads)
+        session.scratchpads.push_back({ slot.pid, slot.window });
+
+    int fd = session.write_to_memfd();
+    if (fd < 0)
+        return;
+
+    setenv(session_fd_env, std::to_string(fd).c_str(), true);
+
+    {
+        TRACE_SPAN("XSync");
+        XSync(m_display, false);
+    }
+
+    LOG(INFO) << "Restarting, handing over " << session.clients.size() << " windows";
+    execv("/proc/self/exe", m_argv);
+
+    LOG(ERROR) << "Could not restart: " << strerror(errno) << " (errno=" << errno << ")";
+    unsetenv(session_fd_env);
+    close(fd);
 }
 
-void WinMan::tile()
+void WinMan::adopt_windows()
 {
-	// XWindowChanges wc;
+    TRACE_SPAN("WinMan::adopt_windows");
 
-	// Raise the always-on-top window
-	for(auto c : m_stack) {
-		if(c.is_aot()) {
-			c.raise_to_top();
-			break;
-		}
-	}
+    auto start = std::chrono::steady_clock::now();
+
+    std::optional<SessionState> session;
+    if (const char* fd = getenv(session_fd_env)) {
+        session = SessionState::read_from_fd(atoi(fd));
+        unsetenv(session_fd_env);
+    }
+
+    // A single QueryTree tells us which windows survived, instead of asking
+    // about each window from the session individually.
+    Window root, parent;
+    Window* children;
+    unsigned int n;
+    {
+        TRACE_SPAN("XQueryTree");
+        if (!XQueryTree(m_display, m_root_window, &root, &parent, &children, &n))
+            return;
+    }
+
+    std::vector<Window> windows(children, children + n);
+    std::unordered_set<Window> alive(windows.begin(), windows.end());
+    if (children)
+        XFree(children);
+
+    unsigned int adopted = 0;
+
+    if (session) {
+        // m_stack is newest first and manage() pushes to the front.
+        for (auto it = session->clients.rbegin(); it != session->clients.rend(); it++) {
+            if (!alive.erase(it->window))
+                continue;
+            manage(Client(m_display, *it));
+            adopted++;
+        }
+        m_monitor.master_size = session->master_size;
+        // Indexes the layouts, so it has to name at least one tag we have.
+        unsigned int tags = session->selected_tags & ((1 << Config::tags.size()) - 1);
+        m_monitor.tags = tags ? tags : 1;
+        for (size_t i = 0; i < std::min(session->layouts.size(), m_monitor.layouts.size()); i++) {
+            if (session->layouts[i] < Layout::Count)
+                m_monitor.layouts[i] = session->layouts[i];
+        }
+
+        for (size_t i = 0; i < std::min(session->scratchpads.size(), m_scratchpads.size()); i++) {
+            ScratchpadSlot& slot = m_scratchpads[i];
+            slot.pid = session->scratchpads[i].pid;
+            if (m_window_to_client_map.contains(session->scratchpads[i].window)) {
+                slot.window = session->scratchpads[i].window;
+                slot.visible = m_window_to_client_map[slot.window].tags() != 0;
+            }
+        }
+    }
+
+    // Windows we didn't know about, either because this is a fresh start or
+    // because they were mapped while nobody was managing them.
+    for (Window window : windows) {
+        if (!alive.contains(window))
+            continue;
+
+        XWindowAttributes attrs;
+        Status status;
+        {
+            TRACE_SPAN("XGetWindowAttributes");
+            status = XGetWindowAttributes(m_display, window, &attrs);
+        }
+        if (!status || attrs.override_redirect || attrs.map_state != IsViewable)
+            continue;
+
+        Client client(m_display, window, { attrs.x, attrs.y }, { attrs.width, attrs.height }, attrs.visual,
+            attrs.depth, true);
+        client.set_tags(m_monitor.tags);
+        manage(client);
+        adopted++;
+    }
+
+    // QueryTree lists the children bottom to top, which is where the
+    // stacking order starts out from.
+    for (Window window : windows) {
+        if (m_window_to_client_map.contains(window))
+            m_geometry.raise(m_window_to_client_map[window].handle());
+    }
+
+    tile();
+
+    if (session && m_window_to_client_map.contains(session->focused))
+        m_window_to_client_map[session->focused].focus();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    LOG(INFO) << "Adopted " << adopted << " windows in " << elapsed.count() << "us";
+}
+
+void WinMan::manage(const Client& client)
+{
+    TRACE_SPAN("WinMan::manage");
+
+    // insert the window into the stack
+    m_stack.insert(m_stack.begin(), client.window());
+    // insert into the map
+
+    // FIXME: Use the [] operator.
+    m_window_to_client_map.emplace(client.window(), client);
+
+    // Get the XEnterWindow and XLeaveWindow events to manage focus, and
+    // PropertyNotify for the properties we keep a copy of.
+    XSelectInput(m_display, client.window(), EnterWindowMask | LeaveWindowMask | PropertyChangeMask);
+    m_dirty_properties[client.window()] = Client::AllProperties;
+
+	// Set window border
+	XSetWindowBorderWidth(m_display, client.window(), m_settings->border_width_in_px);
+	XSetWindowBorder(m_display, client.window(), m_colors[Colors::WindowBorderActive].pixel);
+
+    Client& managed = m_window_to_client_map[client.window()];
+    managed.grab_input();
+    m_geometry.border[managed.handle()] = m_settings->border_width_in_px;
+
+    if (m_overview) {
+        Visual* visual = managed.visual() ? managed.visual() : DefaultVisual(m_display, m_monitor.screen);
+        m_overview->add(managed.window(), visual, managed.size());
+    }
+
+    if (managed.is_floating() && m_frame_pool)
+        frame(managed);
+}
+
+void WinMan::unmanage(Window window)
+{
+    TRACE_SPAN("WinMan::unmanage");
+
+    Client& client = m_window_to_client_map[window];
+
+    m_dirty_properties.erase(window);
+    if (m_overview)
+        m_overview->remove(window);
+
+    // Other windows of the process would otherwise stay stopped for good.
+    cancel_freeze(window);
+    if (client.is_frozen())
+        thaw(client.pid());
+
+    if (client.is_framed()) {
+        // The window might already be destroyed, in which case taking it out
+        // of the frame fails with an error `on_x_error()` knows to ignore.
+        track(window, "unframe");
+        m_frame_pool->release(client.unparent());
+    }
+
+    auto to_delete = std::find(m_stack.begin(), m_stack.end(), window);
+    m_stack.erase(to_delete);
+
+    if (m_focus_cycle.origin == client.handle())
+        m_focus_cycle.origin = GeometryStore::invalid;
+    if (m_focus_cycle.current == client.handle())
+        m_focus_cycle.current = GeometryStore::invalid;
+    m_geometry.remove(client.handle());
+
+    m_window_to_client_map.erase(window);
+
+    if (m_focused == window)
+        m_focused = None;
+
+    for (auto& slot : m_scratchpads) {
+        if (slot.window != window)
+            continue;
+
+        slot.window = None;
+        slot.visible = false;
+        if (slot.pid < 0)
+            schedule_scratchpad_respawn(slot);
+    }
+}
+
+void WinMan::process_x_events()
+{
+    while (XPending(m_display)) {
+        XEvent e;
+        XNextEvent(m_display, &e);
+        handle_event(e);
+    }
+}
+
+void WinMan::handle_event(XEvent& e)
+{
+    LOG(INFO) << "Recieved event: " << Util::x_event_code_to_string(e);
+
+    // Whatever the handler sends is on behalf of the window the event is
+    // about.
+    const char* name = Util::x_event_type_name(e.type);
+    track(e.xany.window, name ? name : "event");
+    TRACE_SPAN(name ? name : "event");
+
+    switch (e.type) {
+    case CreateNotify:
+        on_CreateNotify(e.xcreatewindow);
+        break;
+    case DestroyNotify:
+        on_DestroyNotify(e.xdestroywindow);
+        break;
+    case MapRequest:
+        on_MapRequest(e.xmaprequest);
+        break;
+    case MapNotify:
+        on_MapNotify(e.xmap);
+        break;
+    case UnmapNotify:
+        on_UnmapNotify(e.xunmap);
+        break;
+    case ConfigureRequest:
+        on_ConfigureRequest(e.xconfigurerequest);
+        break;
+    case ConfigureNotify:
+        on_ConfigureNotify(e.xconfigure);
+        break;
+    case KeyPress:
+        on_KeyPress(e.xkey);
+        break;
+    case KeyRelease:
+        on_KeyRelease(e.xkey);
+        break;
+    case EnterNotify:
+        on_EnterNotify(e.xcrossing);
+        break;
+    case LeaveNotify:
+        on_LeaveNotify(e.xcrossing);
+        break;
+    case ButtonPress:
+        on_ButtonPress(e.xbutton);
+        break;
+	case MotionNotify:
+		on_MotionNotify(e.xmotion);
+		break;
+    case PropertyNotify:
+        on_PropertyNotify(e.xproperty);
+        break;
+    case Expose:
+        on_Expose(e.xexpose);
+        break;
+    case MappingNotify:
+        on_MappingNotify(e.xmapping);
+        break;
+    default:
+        if (m_overview && e.type == m_overview->damage_event()) {
+            m_overview->damaged(reinterpret_cast<XDamageNotifyEvent&>(e));
+            break;
+        }
+        if (e.type == m_xkb_event_base && reinterpret_cast<XkbEvent&>(e).any.xkb_type == XkbNewKeyboardNotify) {
+            LOG(INFO) << "New keyboard, updating the keymap";
+            update_keymap();
+            break;
+        }
+        LOG(WARNING) << "[!!!] Non-implemented event " << Util::x_event_code_to_string(e) << " (" << e.type << ")";
+        break;
+    }
+}
+
+void WinMan::update_keymap()
+{
+    TRACE_SPAN("WinMan::update_keymap");
+
+    end_chord();
+
+    // Both only change with the keyboard mapping, so they're looked up here
+    // rather than on every key press.
+    int min_keycode, max_keycode;
+    XDisplayKeycodes(m_display, &min_keycode, &max_keycode);
+    m_keysyms.fill(NoSymbol);
+    for (int keycode = min_keycode; keycode <= max_keycode; keycode++)
+        m_keysyms[keycode] = XkbKeycodeToKeysym(m_display, keycode, 0, 0);
+
+    m_numlock_mask = 0;
+    m_modifiers.fill(0);
+    XModifierKeymap* modmap = XGetModifierMapping(m_display);
+    KeyCode numlock = XKeysymToKeycode(m_display, XK_Num_Lock);
+    for (int i = 0; i < 8 * modmap->max_keypermod; i++) {
+        if (numlock && modmap->modifiermap[i] == numlock)
+            m_numlock_mask = 1 << (i / modmap->max_keypermod);
+        if (modmap->modifiermap[i])
+            m_modifiers[modmap->modifiermap[i]] |= 1 << (i / modmap->max_keypermod);
+    }
+    XFreeModifiermap(modmap);
+
+    m_key_trie.build(m_settings->keybinds, all_modifiers & ~m_numlock_mask);
+    grab_keys();
+}
+
+void WinMan::grab_keys()
+{
+    TRACE_SPAN("WinMan::grab_keys");
+
+    // Every binding is grabbed once for each combination of the lock
+    // modifiers, otherwise it stops working with CapsLock or NumLock on.
+    const unsigned int lock_variants[] = { 0, LockMask, m_numlock_mask, LockMask | m_numlock_mask };
+
+    std::vector<std::pair<KeyCode, unsigned int>> grabs;
+    for (const auto& keybind : m_settings->keybinds) {
+        KeyCode keycode = XKeysymToKeycode(m_display, keybind.keysym());
+        if (!keycode)
+            continue;
+        for (unsigned int lock : lock_variants)
+            grabs.emplace_back(keycode, keybind.modmask() | lock);
+    }
+    std::sort(grabs.begin(), grabs.end());
+    grabs.erase(std::unique(grabs.begin(), grabs.end()), grabs.end());
+
+    // Only the grabs that actually changed go to the server.
+    std::vector<std::pair<KeyCode, unsigned int>> removed, added;
+    std::set_difference(m_key_grabs.begin(), m_key_grabs.end(), grabs.begin(), grabs.end(), std::back_inserter(removed));
+    std::set_difference(grabs.begin(), grabs.end(), m_key_grabs.begin(), m_key_grabs.end(), std::back_inserter(added));
+
+    for (const auto& [keycode, modmask] : removed)
+        XUngrabKey(m_display, keycode, modmask, m_root_window);
+    for (const auto& [keycode, modmask] : added)
+        XGrabKey(m_display, keycode, modmask, m_root_window, true, GrabModeAsync, GrabModeAsync);
+
+    m_key_grabs = std::move(grabs);
+
+    LOG(INFO) << "Key grabs updated: " << removed.size() << " removed, " << added.size() << " added, "
+              << m_key_grabs.size() << " total";
+}
+
+void WinMan::reload_config()
+{
+    TRACE_SPAN("WinMan::reload_config");
+
+    if (!m_config_watcher->consume_events())
+        return;
+
+    auto settings = Settings::load(m_config_path);
+    if (!settings)
+        return;
+
+    apply_settings(std::move(settings));
+}
+
+void WinMan::apply_settings(std::unique_ptr<Settings> settings)
+{
+    SettingsDiff diff = SettingsDiff::between(*m_settings, *settings);
+
+    // The trie points into the old keybinds.
+    end_chord();
+    m_settings = std::move(settings);
+    m_key_trie.build(m_settings->keybinds, all_modifiers & ~m_numlock_mask);
+
+    if (diff.empty()) {
+        LOG(INFO) << "Config reloaded, nothing to re-apply";
+        return;
+    }
+
+    if (!diff.grabs_removed.empty() || !diff.grabs_added.empty())
+        grab_keys();
+
+    if (diff.buttons_changed) {
+        for (Window window : m_stack)
+            m_window_to_client_map[window].grab_input();
+    }
+
+    if (diff.colors_changed || diff.border_width_changed) {
+        if (diff.colors_changed) {
+            alloc_colors();
+            if (m_overview)
+                m_overview->set_colors(m_colors[Colors::BarBackground], m_colors[Colors::WindowBorderActive]);
+        }
+
+        int revert;
+        Window focused;
+        XGetInputFocus(m_display, &focused, &revert);
+
+        for (Window window : m_stack) {
+            Window outer = m_window_to_client_map[window].outer_window();
+            if (diff.border_width_changed) {
+                XSetWindowBorderWidth(m_display, outer, m_settings->border_width_in_px);
+                m_geometry.border[m_window_to_client_map[window].handle()] = m_settings->border_width_in_px;
+            }
+            if (diff.colors_changed) {
+                Colors color = window == focused ? Colors::WindowBorderActive : Colors::WindowBorderInactive;
+                XSetWindowBorder(m_display, outer, m_colors[color].pixel);
+            }
+        }
+
+        if (diff.colors_changed && m_bar) {
+            m_bar->set_colors({ m_colors[Colors::BarForeground].pixel, m_colors[Colors::BarBackground].pixel,
+                m_colors[Colors::BarSelectedForeground].pixel, m_colors[Colors::BarSelectedBackground].pixel });
+            m_bar->redraw();
+        }
+    }
+
+    if (diff.layout_changed || diff.border_width_changed) {
+        m_monitor.master_size = m_settings->master_size;
+        tile();
+    }
+
+    LOG(INFO) << "Config reloaded: " << diff.grabs_removed.size() << " key grabs removed, "
+              << diff.grabs_added.size() << " added"
+              << (diff.buttons_changed ? ", buttons" : "")
+              << (diff.colors_changed ? ", colors" : "")
+              << (diff.border_width_changed ? ", border width" : "")
+              << (diff.layout_changed ? ", layout" : "") << " changed";
+}
+
+void WinMan::alloc_colors()
+{
+    for (auto& [color, xcolor] : m_colors)
+        XFreeColors(m_display, m_colormap, &xcolor.pixel, 1, 0);
+    m_colors.clear();
+
+    for (const auto& [color, value] : m_settings->colors) {
+        XColor xcolor;
+        if (!XParseColor(m_display, m_colormap, value.c_str(), &xcolor) || !XAllocColor(m_display, m_colormap, &xcolor)) {
+            LOG(WARNING) << "Could not allocate color " << value;
+            xcolor.pixel = BlackPixel(m_display, m_monitor.screen);
+        }
+        m_colors[color] = xcolor;
+    }
+}
+
+void WinMan::on_CreateNotify(const XCreateWindowEvent&)
+{
+    for (unsigned long i = 0; i < m_stack.size(); i++) {
+        LOG(INFO) << "STACK :: Position " << i << " = " << m_stack[i];
+    }
+}
+void WinMan::on_DestroyNotify(const XDestroyWindowEvent& e)
+{
+    LOG(INFO) << "Destoryed window " << e.window;
+
+    // Unmapped windows (hidden scratchpads) go away without an UnmapNotify.
+    if (m_window_to_client_map.contains(e.window)) {
+        unmanage(e.window);
+        tile();
+        if (m_focused == None)
+            focus_most_recent();
+    }
+}
+
+Task WinMan::on_MapRequest(XMapRequestEvent e)
+{
+    if (m_window_to_client_map.contains(e.window)) {
+        m_window_to_client_map[e.window].map();
+        co_return;
+    }
+
+    // Clients like to map the same window again while we wait for replies.
+    if (!m_pending_maps.insert(e.window).second)
+        co_return;
+
+    // All requests go out before waiting for the first reply, and other
+    // events are handled in the meantime. Each part between two waits is a
+    // span of its own, the time waiting in between shows up as the gap.
+    uint64_t requested = Trace::enabled() ? Trace::now_ns() : 0;
+    auto attributes_cookie = xcb_get_window_attributes(m_xcb, e.window);
+    auto geometry_cookie = xcb_get_geometry(m_xcb, e.window);
+    // Only while something is waiting for a window, that's one more request
+    // on every MapRequest otherwise.
+    bool scratchpad = scratchpad_waiting();
+    xcb_get_property_cookie_t class_cookie {};
+    if (scratchpad)
+        class_cookie = xcb_get_property(m_xcb, false, e.window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 256);
+
+    if (requested)
+        Trace::record("MapRequest (requests)", requested, Trace::now_ns());
+
+    auto attributes = co_await m_replies.reply<xcb_get_window_attributes_reply_t>(attributes_cookie.sequence);
+    auto geometry = co_await m_replies.reply<xcb_get_geometry_reply_t>(geometry_cookie.sequence);
+    XcbReply<xcb_get_property_reply_t> win_class;
+    if (scratchpad)
+        win_class = co_await m_replies.reply<xcb_get_property_reply_t>(class_cookie.sequence);
+
+    m_pending_maps.erase(e.window);
+    // Picking up where the MapRequest left off, after other events.
+    track(e.window, "MapRequest");
+    TRACE_SPAN("MapRequest (replies)");
+
+    if (!attributes || !geometry) {
+        LOG(INFO) << "Window " << e.window << " went away before it could be managed";
+        co_return;
+    }
+
+    Client new_client { m_display, e.window, { geometry->x, geometry->y }, { geometry->width, geometry->height },
+        find_visual(m_display, attributes->visual), geometry->depth,
+        attributes->map_state != XCB_MAP_STATE_UNMAPPED };
+
+    if (win_class) {
+        // WM_CLASS is the instance and the class, both null terminated.
+        const char* value = static_cast<const char*>(xcb_get_property_value(win_class.get()));
+        std::string instance(value, strnlen(value, xcb_get_property_value_length(win_class.get())));
+        std::string class_name;
+        if (instance.size() + 1 < static_cast<size_t>(xcb_get_property_value_length(win_class.get())))
+            class_name.assign(value + instance.size() + 1,
+                strnlen(value + instance.size() + 1, xcb_get_property_value_length(win_class.get()) - instance.size() - 1));
+
+        if (capture_scratchpad(new_client, instance.c_str(), class_name.c_str()))
+            co_return;
+    }
+
+    LOG(INFO) << "Created window " << e.window;
+
+    new_client.set_tags(m_monitor.tags);
+
+    manage(new_client);
+
+    tile();
+
+    Client& client = m_window_to_client_map[e.window];
+    client.map();
+
+    client.focus();
+
+    set_crossing_barrier();
+}
+
+void WinMan::on_MapNotify(const XMapEvent& e)
+{
+    LOG(INFO) << "Mapped window " << e.window;
+}
+
+void WinMan::on_UnmapNotify(const XUnmapEvent& e)
+{
+    if (!m_window_to_client_map.contains(e.window)) {
+        LOG(INFO) << "Ignore UnmapNotify for non-client window " << e.window;
+        return;
+    }
+
+    if (m_window_to_client_map[e.window].consume_expected_unmap()) {
+        LOG(INFO) << "Ignore UnmapNotify caused by reparenting window " << e.window;
+        return;
+    }
+
+    unmanage(e.window);
+
+    LOG(INFO) << "Unmapped window " << e.window;
+
+    tile();
+    if (m_focused == None)
+        focus_most_recent();
+}
+
+void WinMan::on_ConfigureRequest(const XConfigureRequestEvent& e)
+{
+    // Not ours (yet), so it gets whatever it asks for.
+    if (!m_window_to_client_map.contains(e.window)) {
+        XWindowChanges changes;
+        changes.x = e.x;
+        changes.y = e.y;
+        changes.width = e.width;
+        changes.height = e.height;
+        changes.border_width = e.border_width;
+        changes.sibling = e.above;
+        changes.stack_mode = e.detail;
+
+        XConfigureWindow(m_display, e.window, e.value_mask, &changes);
+        return;
+    }
+
+    Client& client = m_window_to_client_map[e.window];
+    GeometryStore::Handle handle = client.handle();
+
+    // Stacking is passed on through our own record of it, which `restack()`
+    // then has the server follow, always-on-top windows staying on top.
+    // Siblings aren't, clients don't get to know about each other's windows.
+    if (e.value_mask & CWStackMode && (e.detail == Above || e.detail == Below)) {
+        if (e.detail == Above)
+            m_geometry.raise(handle);
+        else
+            m_geometry.lower(handle);
+        // Windows may have been managed since the last `tile()`.
+        m_geometry.filter_by_tags(m_monitor.tags, m_visible);
+        restack();
+    }
+
+    // Tiled and fullscreen windows stay where they are. Answering with where
+    // that is, and leaving the server out of it, is what keeps a client that
+    // insists on its own size from starting a configure storm.
+    if (!(e.value_mask & (CWX | CWY | CWWidth | CWHeight)) || !m_geometry.has(handle, GeometryStore::Floating)
+        || m_geometry.has(handle, GeometryStore::Fullscreen)) {
+        client.send_configure_notify();
+        return;
+    }
+
+    Position<int> pos = client.position();
+    Size<int> size = client.size();
+    if (e.value_mask & CWWidth)
+        size.width = e.width;
+    if (e.value_mask & CWHeight)
+        size.height = e.height;
+    if (e.value_mask & CWX)
+        pos.x = e.x;
+    if (e.value_mask & CWY)
+        pos.y = e.y;
+
+    // Kept on the monitor, whole if it fits.
+    int border = m_geometry.border[handle];
+    int frame_offset = client.is_framed() ? Config::frame_title_height_in_px : 0;
+    size.width = std::clamp(size.width, 1, std::max(1, m_monitor.size.width - 2 * border));
+    size.height = std::clamp(size.height, 1, std::max(1, m_monitor.size.height - 2 * border - frame_offset));
+    pos.x = std::clamp(pos.x, 0, m_monitor.size.width - size.width - 2 * border);
+    pos.y = std::clamp(pos.y, 0, m_monitor.size.height - size.height - 2 * border - frame_offset);
+
+    if (pos.x == client.position().x && pos.y == client.position().y && size.width == client.size().width
+        && size.height == client.size().height) {
+        client.send_configure_notify();
+        return;
+    }
+
+    client.move_resize(pos, size);
+    LOG(INFO) << "Configured floating window " << e.window << " to " << size << " at " << pos;
+}
+
+void WinMan::on_ConfigureNotify(const XConfigureEvent& e)
+{
+    LOG(INFO) << "Configured window " << e.window;
+}
+
+void WinMan::on_KeyPress(const XKeyPressedEvent& e)
+{
+    m_pointer = { e.x_root, e.y_root };
+
+    KeySym key = m_keysyms[e.keycode];
+
+    if (m_overview && m_overview->is_open()) {
+        overview_key(key, e.state);
+        return;
+    }
+
+    if (m_focus_cycle.active && key == XK_Escape) {
+        end_focus_cycle(false);
+        return;
+    }
+
+    // Pressing Shift and such on the way to the next key of a chord isn't a
+    // step of its own.
+    if (m_chord_node != KeyTrie::root && IsModifierKey(key))
+        return;
+
+    auto node = m_key_trie.step(m_chord_node, e.state, key);
+
+    // Any other key than the one cycling the focus, except for modifiers on
+    // the way to it, ends the cycle where it is.
+    if (m_focus_cycle.active && !IsModifierKey(key)) {
+        const Keybind* keybind = node ? m_key_trie.binding(*node) : nullptr;
+        if (!keybind || keybind->action() != KeyAction::StackFocus)
+            end_focus_cycle(true);
+    }
+
+    if (!node) {
+        if (m_chord_node != KeyTrie::root)
+            LOG(INFO) << "Key " << XKeysymToString(key) << " doesn't continue the chord, cancelled";
+        end_chord();
+        return;
+    }
+
+    if (m_key_trie.has_children(*node)) {
+        // Only the first key of every binding is grabbed, the rest of a chord
+        // is read through a keyboard grab that lasts until it's done.
+        if (m_chord_node == KeyTrie::root
+            && XGrabKeyboard(m_display, m_root_window, false, GrabModeAsync, GrabModeAsync, CurrentTime) != GrabSuccess) {
+            LOG(WARNING) << "Could not grab the keyboard for a chord";
+            return;
+        }
+        m_chord_node = *node;
+
+        if (m_chord_timer)
+            m_loop.cancel_timer(m_chord_timer);
+        m_chord_timer = m_loop.add_timer(std::chrono::milliseconds(Config::chord_timeout_in_ms), [this] {
+            m_chord_timer = 0;
+            LOG(INFO) << "Chord timed out";
+            end_chord();
+        });
+        return;
+    }
+
+    end_chord();
+    if (const Keybind* keybind = m_key_trie.binding(*node))
+        keybind->execute();
+
+    // Actions move, restack and close windows under the pointer.
+    set_crossing_barrier();
+}
+
+void WinMan::end_chord()
+{
+    if (m_chord_node == KeyTrie::root)
+        return;
+
+    m_chord_node = KeyTrie::root;
+    XUngrabKeyboard(m_display, CurrentTime);
+    if (m_chord_timer) {
+        m_loop.cancel_timer(m_chord_timer);
+        m_chord_timer = 0;
+    }
+}
+
+void WinMan::on_KeyRelease(const XKeyReleasedEvent& e)
+{
+    // The state is from before the release, so without the key's own
+    // modifier it's what is still held.
+    if (m_focus_cycle.active && !(e.state & ~m_modifiers[e.keycode] & m_focus_cycle.modmask))
+        end_focus_cycle(true);
+}
+
+void WinMan::on_EnterNotify(const XEnterWindowEvent& e)
+{
+    m_pointer = { e.x_root, e.y_root };
+
+    // Only follow the pointer when the user moved it, not when a window
+    // appeared under it because of something we did or because of a grab.
+    if (e.serial < m_crossing_barrier_serial || e.mode != NotifyNormal) {
+        m_suppressed_crossings++;
+        VLOG(1) << "Suppressed EnterNotify for window " << e.window << " (serial " << e.serial
+                << ", mode " << e.mode << "), " << m_suppressed_crossings << " suppressed so far";
+        return;
+    }
+
+    if (!m_window_to_client_map.contains(e.window) || e.window == m_focused)
+        return;
+
+    Client& client = m_window_to_client_map[e.window];
+    if (m_window_to_client_map.contains(m_focused))
+        m_window_to_client_map[m_focused].unfocus();
+    client.focus();
+}
+
+void WinMan::on_LeaveNotify(const XLeaveWindowEvent& e)
+{
+    m_pointer = { e.x_root, e.y_root };
+}
+
+void WinMan::on_ButtonPress(const XButtonPressedEvent& e)
+{
+    m_pointer = { e.x_root, e.y_root };
+
+    if (m_overview && m_overview->is_open() && e.window == m_overview->window()) {
+        if (Window window = m_overview->window_at({ e.x, e.y }))
+            overview_pick(window);
+        else
+            m_overview->close();
+    }
+}
+
+void WinMan::on_MotionNotify(const XMotionEvent& e)
+{
+    m_pointer = { e.x_root, e.y_root };
+}
+
+void WinMan::on_PropertyNotify(const XPropertyEvent& e)
+{
+    if (e.window == m_root_window) {
+        if (e.atom == XA_WM_NAME)
+            schedule_status_update();
+        return;
+    }
+
+    uint8_t property = 0;
+    if (e.atom == XA_WM_NAME || e.atom == m_netatom[NetAtom::NetName])
+        property = Client::TitleProperty;
+    else if (e.atom == XA_WM_HINTS)
+        property = Client::HintsProperty;
+    else if (e.atom == XA_WM_NORMAL_HINTS)
+        property = Client::NormalHintsProperty;
+
+    // Only noted here, terminals and browsers change their title many times
+    // a second and there's no point fetching all of those.
+    if (property && m_window_to_client_map.contains(e.window))
+        m_dirty_properties[e.window] |= property;
+}
+
+void WinMan::fetch_properties()
+{
+    if (m_dirty_properties.empty())
+        return;
+
+    TRACE_SPAN("WinMan::fetch_properties");
+
+    // One job per window for whatever changed in this batch. A window whose
+    // last fetch is still out waits for it, the fetch after that gets
+    // everything that changed meanwhile.
+    for (auto it = m_dirty_properties.begin(); it != m_dirty_properties.end();) {
+        Window window = it->first;
+        uint8_t properties = it->second;
+        if (m_fetching_properties.contains(window)) {
+            ++it;
+            continue;
+        }
+
+        // The class and title are only needed to look up freeze rules, no
+        // point fetching them without any.
+        bool freeze_rules = properties & Client::ProcessProperty
+            && std::any_of(m_settings->rules.begin(), m_settings->rules.end(),
+                [](const Rule& rule) { return rule.freeze != FreezePolicy::Unset; });
+        bool cgroups = m_cgroups.enabled();
+        Atom pid_atom = m_netatom[NetAtom::NetWMPid];
+
+        bool posted = m_worker->post([this, window, properties, freeze_rules, cgroups, pid_atom,
+                                         hostname = m_hostname](Display* display) -> Worker::Result {
+            std::string title;
+            bool urgent = false;
+            SizeHints hints {};
+            ProcessProperties process;
+
+            if (properties & Client::TitleProperty)
+                title = fetch_name(display, window);
+            if (properties & Client::HintsProperty) {
+                if (XWMHints* wm_hints = XGetWMHints(display, window)) {
+                    urgent = wm_hints->flags & XUrgencyHint;
+                    XFree(wm_hints);
+                }
+            }
+            if (properties & Client::NormalHintsProperty)
+                hints = fetch_size_hints(display, window);
+            if (properties & Client::ProcessProperty)
+                process = fetch_process(display, window, pid_atom, hostname, cgroups, freeze_rules);
+
+            return [this, window, properties, title = std::move(title), urgent, hints, freeze_rules,
+                       process = std::move(process)] {
+                m_fetching_properties.erase(window);
+                if (!m_window_to_client_map.contains(window))
+                    return;
+
+                Client& client = m_window_to_client_map[window];
+                if (properties & Client::TitleProperty)
+                    client.set_title(title);
+                if (properties & Client::HintsProperty)
+                    client.set_urgent(urgent && window != m_focused);
+                if (properties & Client::NormalHintsProperty && hints != client.size_hints()) {
+                    client.set_size_hints(hints);
+                    // Terminals that just learned their font size and such.
+                    GeometryStore::Handle handle = client.handle();
+                    if (!m_geometry.has(handle, GeometryStore::Floating) && !m_geometry.has(handle, GeometryStore::Hidden))
+                        tile();
+                }
+                if (properties & Client::ProcessProperty) {
+                    client.set_pid(process.pid);
+                    if (m_cgroups.usage(process.cgroup)) {
+                        client.set_cgroup(process.cgroup);
+                        if (window == m_focused)
+                            update_bar_usage();
+                    }
+                    if (freeze_rules
+                        && should_freeze(process.instance.c_str(), process.class_name.c_str(), process.title)) {
+                        client.set_freezable(true);
+                        // It may have been hidden before we knew.
+                        if (m_geometry.has(client.handle(), GeometryStore::Hidden))
+                            schedule_freeze(client);
+                    }
+                }
+            };
+        });
+        // The rest waits until jobs finish, see `run()`.
+        if (!posted)
+            break;
+
+        m_fetching_properties.insert(window);
+        it = m_dirty_properties.erase(it);
+    }
+}
+
+void WinMan::on_MappingNotify(XMappingEvent& e)
+{
+    // Refreshes Xlib's own copy, which XKeysymToKeycode() works from.
+    XRefreshKeyboardMapping(&e);
+
+    if (e.request == MappingKeyboard || e.request == MappingModifier)
+        update_keymap();
+}
+
+void WinMan::on_Expose(const XExposeEvent& e)
+{
+    if (m_bar && e.window == m_bar->window() && e.count == 0)
+        m_bar->expose();
+    else if (m_overview && e.window == m_overview->window() && e.count == 0)
+        m_overview->expose();
+}
+
+void WinMan::update_bar()
+{
+    TRACE_SPAN("WinMan::update_bar");
+
+    if (!m_bar)
+        return;
+
+    unsigned int occupied = 0;
+    unsigned int urgent = 0;
+    for (Window window : m_stack) {
+        const Client& client = m_window_to_client_map[window];
+        occupied |= client.tags();
+        if (client.is_urgent())
+            urgent |= client.tags();
+    }
+    m_bar->set_tags(m_monitor.tags, occupied, urgent);
+    m_bar->set_layout(layout_symbol(current_layout()));
+
+    // Titles are kept up to date by `fetch_properties()`, nothing to fetch.
+    auto focused = m_window_to_client_map.find(m_focused);
+    m_bar->set_title(focused != m_window_to_client_map.end() ? focused->second.title() : "");
+
+    if (m_bar_focused != m_focused) {
+        m_bar_focused = m_focused;
+        update_bar_usage();
+    }
+
+    m_bar->redraw();
+}
+
+void WinMan::update_bar_usage()
+{
+    if (!m_bar || !m_cgroups.enabled())
+        return;
+
+    std::optional<CgroupUsage> usage;
+    if (m_focused != None && m_window_to_client_map.contains(m_focused))
+        usage = m_cgroups.usage(m_window_to_client_map[m_focused].cgroup());
+
+    if (!usage) {
+        m_bar->set_usage("");
+        return;
+    }
+
+    char text[32];
+    snprintf(text, sizeof(text), "%.0f%% %luM", usage->cpu_percent,
+        static_cast<unsigned long>(usage->memory_bytes >> 20));
+    m_bar->set_usage(text);
+}
+
+void WinMan::update_cgroups()
+{
+    TRACE_SPAN("WinMan::update_cgroups");
+
+    m_cgroups.update();
+    update_bar_usage();
+
+    m_loop.add_timer(std::chrono::milliseconds(Config::cgroup_stats_interval_in_ms), [this] { update_cgroups(); });
+}
+
+void WinMan::publish_snapshot()
+{
+    if (!m_snapshot.enabled())
+        return;
+
+    TRACE_SPAN("WinMan::publish_snapshot");
+
+    Snapshot::State& state = m_snapshot.state();
+    state.focused = m_focused;
+    state.monitor = { 0, 0, m_monitor.size.width, m_monitor.size.height, m_monitor.tags,
+        static_cast<uint32_t>(Config::tags.size()), static_cast<uint32_t>(current_layout()), m_monitor.master_count,
+        m_monitor.master_size };
+    state.stats = { m_layouts.hits(), m_layouts.misses() };
+
+    uint32_t count = 0;
+    for (Window window : m_stack) {
+        if (count == Snapshot::max_clients)
+            break;
+
+        const Client& client = m_window_to_client_map[window];
+        GeometryStore::Handle handle = client.handle();
+        Snapshot::Client& entry = state.clients[count++];
+        entry.window = window;
+        entry.x = m_geometry.x[handle];
+        entry.y = m_geometry.y[handle];
+        entry.width = m_geometry.width[handle];
+        entry.height = m_geometry.height[handle];
+        entry.tags = m_geometry.tags[handle];
+        uint32_t flags = 0;
+        if (m_geometry.has(handle, GeometryStore::Floating))
+            flags |= Snapshot::Floating;
+        if (m_geometry.has(handle, GeometryStore::Fullscreen))
+            flags |= Snapshot::Fullscreen;
+        if (m_geometry.has(handle, GeometryStore::AlwaysOnTop))
+            flags |= Snapshot::AlwaysOnTop;
+        if (client.is_urgent())
+            flags |= Snapshot::Urgent;
+        if (window == m_focused)
+            flags |= Snapshot::Focused;
+        if (m_geometry.tags[handle] & m_monitor.tags)
+            flags |= Snapshot::Visible;
+        entry.flags = flags;
+        entry.pid = client.pid();
+        // Pads with zeroes, so unchanged entries compare equal.
+        strncpy(entry.title, client.title().c_str(), sizeof(entry.title) - 1);
+    }
+    state.client_count = count;
+
+    m_snapshot.publish();
+}
+
+void WinMan::schedule_status_update()
+{
+    if (!m_bar || m_status_timer)
+        return;
+
+    // Status scripts tend to update far more often than anyone can read, so
+    // changes in between are coalesced into a single fetch and redraw.
+    auto interval = std::chrono::milliseconds(Config::bar_status_interval_in_ms);
+    auto since_last = EventLoop::Clock::now() - m_last_status_update;
+
+    if (since_last >= interval) {
+        update_status();
+        return;
+    }
+
+    auto delay = std::chrono::ceil<std::chrono::milliseconds>(interval - since_last);
+    m_status_timer = m_loop.add_timer(delay, [this] {
+        m_status_timer = 0;
+        update_status();
+    });
+}
+
+void WinMan::update_status()
+{
+    m_last_status_update = EventLoop::Clock::now();
+
+    Window root = m_root_window;
+    m_worker->post([this, root](Display* display) -> Worker::Result {
+        return [this, status = fetch_name(display, root)] {
+            m_bar->set_status(status.empty() ? "pluswm" : status);
+        };
+    });
+}
+
+void WinMan::set_crossing_barrier()
+{
+    // Every event the server generates while processing our requests carries
+    // the serial of the last request it processed. Anything that happens
+    // after it got to this NoOp has at least the NoOp's serial.
+    m_crossing_barrier_serial = NextRequest(m_display);
+    XNoOp(m_display);
+}
+
+LayoutParams WinMan::layout_params() const
+{
+    int bar_height = m_bar ? m_bar->height() : 0;
+    const Gaps& gaps = m_settings->gaps;
+
+    return {
+        m_monitor.layouts[__builtin_ctz(m_monitor.tags)],
+        0,
+        bar_height,
+        m_monitor.size.width,
+        m_monitor.size.height - bar_height,
+        m_monitor.master_size,
+        m_monitor.master_count,
+        static_cast<int>(gaps.in_h),
+        static_cast<int>(gaps.in_v),
+        static_cast<int>(gaps.out_h),
+        static_cast<int>(gaps.out_v),
+        m_settings->smart_gaps,
+        static_cast<int>(m_settings->border_width_in_px),
+    };
+}
+
+bool WinMan::should_freeze(const char* instance, const char* class_name, const std::string& title) const
+{
+    // Same as dwm, every matcher given has to be contained in the property.
+    auto matches = [&](const Rule& rule) {
+        return (!rule.win_class || strstr(class_name, rule.win_class))
+            && (!rule.win_instance || strstr(instance, rule.win_instance))
+            && (!rule.win_title || strstr(title.c_str(), rule.win_title));
+    };
+
+    bool freeze = false;
+    for (const auto& rule : m_settings->rules) {
+        if (rule.freeze == FreezePolicy::Unset || !matches(rule))
+            continue;
+        if (rule.freeze == FreezePolicy::Exempt)
+            return false;
+        freeze = true;
+    }
+    return freeze;
+}
+
+void WinMan::schedule_freeze(Client& client)
+{
+    if (!client.is_freezable() || client.is_frozen() || m_freeze_timers.contains(client.window()))
+        return;
+
+    Window window = client.window();
+    m_freeze_timers[window] = m_loop.add_timer(std::chrono::milliseconds(Config::freeze_hidden_after_in_ms),
+        [this, window] {
+            m_freeze_timers.erase(window);
+            freeze(window);
+        });
+}
+
+void WinMan::cancel_freeze(Window window)
+{
+    auto it = m_freeze_timers.find(window);
+    if (it == m_freeze_timers.end())
+        return;
+
+    m_loop.cancel_timer(it->second);
+    m_freeze_timers.erase(it);
+}
+
+void WinMan::freeze(Window window)
+{
+    if (!m_window_to_client_map.contains(window))
+        return;
+
+    pid_t pid = m_window_to_client_map[window].pid();
+    if (pid <= 1)
+        return;
+
+    // A process with any window still in view, or one no rule allows
+    // freezing, keeps running.
+    for (auto& [other_window, other] : m_window_to_client_map) {
+        if (other.pid() == pid
+            && (!other.is_freezable() || !m_geometry.has(other.handle(), GeometryStore::Hidden)))
+            return;
+    }
+
+    LOG(INFO) << "Stopping process " << pid << ", its windows have been hidden for "
+              << Config::freeze_hidden_after_in_ms << "ms";
+    for (auto& [other_window, other] : m_window_to_client_map) {
+        if (other.pid() == pid)
+            other.freeze();
+    }
+}
+
+void WinMan::thaw_all()
+{
+    for (auto& [window, client] : m_window_to_client_map) {
+        cancel_freeze(window);
+        client.thaw();
+    }
+}
+
+int WinMan::on_x_io_error(Display*)
+{
+    LOG(ERROR) << "Lost the connection to the X server";
+    get().thaw_all();
+    exit(EXIT_FAILURE);
+}
+
+void WinMan::on_fatal()
+{
+    get().thaw_all();
+    abort();
+}
+
+void WinMan::thaw(pid_t pid)
+{
+    LOG(INFO) << "Resuming process " << pid;
+    for (auto& [window, client] : m_window_to_client_map) {
+        if (client.pid() == pid)
+            client.thaw();
+    }
+}
+
+Layout& WinMan::current_layout()
+{
+    return m_monitor.layouts[__builtin_ctz(m_monitor.tags)];
+}
+
+void WinMan::tile()
+{
+    TRACE_SPAN("WinMan::tile");
+
+    m_geometry.filter_by_tags(m_monitor.tags, m_visible);
+
+    // Newest first, so the newest window is the master.
+    m_tiled.clear();
+    for (Window window : m_stack) {
+        Client& client = m_window_to_client_map[window];
+        GeometryStore::Handle handle = client.handle();
+        if (m_visible[handle] && !m_geometry.has(handle, GeometryStore::Floating)
+            && !m_geometry.has(handle, GeometryStore::Fullscreen))
+            m_tiled.push_back(&client);
+    }
+
+    // Stopped processes coming into view are resumed first, so they're
+    // already redrawing by the time their windows are moved back.
+    for (Window window : m_stack) {
+        Client& client = m_window_to_client_map[window];
+        if (m_visible[client.handle()] && client.is_frozen())
+            thaw(client.pid());
+    }
+
+    unsigned long misses = m_layouts.misses();
+    const LayoutResult& layout = m_layouts.get(layout_params(), m_tiled.size());
+    if (m_layouts.misses() != misses)
+        VLOG(1) << "Layout cache miss for " << m_tiled.size() << " windows, " << m_layouts.hits() << " hits and "
+                << m_layouts.misses() << " misses so far";
+
+    // Only windows that actually end up somewhere else get a request. Size
+    // hints are applied right here from the cached copy, so a terminal gets
+    // a size it's happy with in one go instead of asking for another.
+    for (size_t i = 0; i < m_tiled.size(); i++) {
+        GeometryStore::Handle handle = m_tiled[i]->handle();
+        Size<int> size { layout.width[i], layout.height[i] };
+        if (Config::respect_size_hints && m_geometry.has(handle, GeometryStore::Constrained))
+            size = apply_size_hints(m_geometry.hints[handle], size);
+
+        if (m_geometry.x[handle] != layout.x[i] || m_geometry.y[handle] != layout.y[i]
+            || m_geometry.width[handle] != size.width || m_geometry.height[handle] != size.height) {
+            track(m_tiled[i]->window(), "tile");
+            m_tiled[i]->move_resize({ layout.x[i], layout.y[i] }, size);
+        }
+    }
+
+    // After the layout, so windows coming into view go straight to where
+    // they belong now.
+    for (Window window : m_stack) {
+        Client& client = m_window_to_client_map[window];
+        if (m_visible[client.handle()]) {
+            client.show();
+            cancel_freeze(window);
+        } else {
+            client.hide();
+            schedule_freeze(client);
+        }
+    }
+
+    restack();
+
+    set_crossing_barrier();
+}
+
+void WinMan::restack()
+{
+    // Always-on-top windows go above the rest, in a single restack and only
+    // when our own record of the stacking order says something is out of
+    // place.
+    if (!m_geometry.restack(m_visible, m_stacking))
+        return;
+
+    m_restack.clear();
+    for (GeometryStore::Handle handle : m_stacking)
+        m_restack.push_back(m_window_to_client_map[m_geometry.window[handle]].outer_window());
+
+    track(None, "restack");
+    // XRestackWindows leaves the first window where it is.
+    XRaiseWindow(m_display, m_restack.front());
+    XRestackWindows(m_display, m_restack.data(), m_restack.size());
+}
+
+void WinMan::focus_under_pointer()
+{
+    GeometryStore::Handle handle = m_geometry.hit_test(m_pointer, m_monitor.tags);
+    if (handle == GeometryStore::invalid || m_geometry.window[handle] == m_focused)
+        return;
+
+    focus_client(m_window_to_client_map[m_geometry.window[handle]]);
+}
+
+void WinMan::focus_most_recent()
+{
+    GeometryStore::Handle handle = m_geometry.most_recent(m_monitor.tags);
+    if (handle == GeometryStore::invalid)
+        return;
+
+    focus_client(m_window_to_client_map[m_geometry.window[handle]]);
+}
+
+void WinMan::focus_client(Client& client)
+{
+    if (client.window() == m_focused)
+        return;
+
+    if (m_window_to_client_map.contains(m_focused))
+        m_window_to_client_map[m_focused].unfocus();
+    client.focus();
+}
+
+void WinMan::cycle_focus(int steps, unsigned int modmask)
+{
+    if (!m_focus_cycle.active) {
+        GeometryStore::Handle focused = GeometryStore::invalid;
+        if (m_window_to_client_map.contains(m_focused))
+            focused = m_window_to_client_map[m_focused].handle();
+        // Shift usually picks the direction, letting go of it doesn't end
+        // anything.
+        m_focus_cycle = { false, modmask & ~(ShiftMask | LockMask | m_numlock_mask), focused, focused };
+
+        // The keyboard grab is what delivers the modifiers' release. Without
+        // any to hold every press is a cycle of its own, which goes back and
+        // forth between the two most recent windows.
+        if (m_focus_cycle.modmask
+            && XGrabKeyboard(m_display, m_root_window, false, GrabModeAsync, GrabModeAsync, CurrentTime) == GrabSuccess) {
+            // They may have been released before the grab took effect, and
+            // then no release ever comes.
+            Window root, child;
+            int root_x, root_y, x, y;
+            unsigned int mask = 0;
+            {
+                TRACE_SPAN("XQueryPointer");
+                XQueryPointer(m_display, m_root_window, &root, &child, &root_x, &root_y, &x, &y, &mask);
+            }
+            m_focus_cycle.active = mask & m_focus_cycle.modmask;
+            if (!m_focus_cycle.active)
+                XUngrabKeyboard(m_display, CurrentTime);
+        }
+    }
+
+    GeometryStore::Handle next = m_geometry.cycle_focus(m_focus_cycle.current, steps, m_monitor.tags);
+    if (next == GeometryStore::invalid)
+        return;
+    m_focus_cycle.current = next;
+
+    Client& client = m_window_to_client_map[m_geometry.window[next]];
+    focus_client(client);
+    client.raise_to_top();
+    restack();
+}
+
+void WinMan::end_focus_cycle(bool keep)
+{
+    if (!m_focus_cycle.active)
+        return;
+
+    m_focus_cycle.active = false;
+    XUngrabKeyboard(m_display, CurrentTime);
+
+    if (!keep && m_focus_cycle.origin != GeometryStore::invalid) {
+        Client& client = m_window_to_client_map[m_geometry.window[m_focus_cycle.origin]];
+        focus_client(client);
+        client.raise_to_top();
+        restack();
+        return;
+    }
+
+    if (m_window_to_client_map.contains(m_focused))
+        m_geometry.focused(m_window_to_client_map[m_focused].handle());
+}
+
+void WinMan::push_focused(int steps)
+{
+    if (!m_window_to_client_map.contains(m_focused))
+        return;
+
+    // Only the tiled windows on the viewed tags have a place to swap.
+    m_geometry.filter_by_tags(m_monitor.tags, m_visible);
+    auto tiled = [this](Window window) {
+        GeometryStore::Handle handle = m_window_to_client_map[window].handle();
+        return m_visible[handle] && !m_geometry.has(handle, GeometryStore::Floating)
+            && !m_geometry.has(handle, GeometryStore::Fullscreen);
+    };
+
+    auto it = std::find(m_stack.begin(), m_stack.end(), m_focused);
+    if (!tiled(*it))
+        return;
+
+    for (int step = 0; step < std::abs(steps); step++) {
+        auto other = it;
+        do {
+            if (steps > 0)
+                other = std::next(other) == m_stack.end() ? m_stack.begin() : std::next(other);
+            else
+                other = other == m_stack.begin() ? std::prev(m_stack.end()) : std::prev(other);
+        } while (other != it && !tiled(*other));
+
+        if (other == it)
+            return;
+        std::iter_swap(it, other);
+        it = other;
+    }
+
+    tile();
 }
 
 XColor WinMan::color(Colors color) const
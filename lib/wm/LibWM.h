@@ -4,19 +4,36 @@
 
 #pragma once
 
+#include <LibBar.h>
+#include <LibCgroup.h>
 #include <LibClient.h>
+#include <LibEventLoop.h>
+#include <LibFrame.h>
+#include <LibGeometry.h>
+#include <LibKeybind.h>
+#include <LibOverview.h>
+#include <LibRequests.h>
+#include <LibSnapshot.h>
+#include <LibTask.h>
 #include <LibUtil.h>
+#include <LibWorker.h>
 #include <X11/XF86keysym.h>
 #include <X11/Xlib.h>
 #include <X11/keysym.h>
+#include <array>
 #include <map>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using Util::Position;
 using Util::Size;
 
+class Settings;
+class ConfigWatcher;
+
 enum WMAtom { WMProtocols = 0,
     WMDelete,
     WMState,
@@ -26,12 +43,17 @@ enum WMAtom { WMProtocols = 0,
 enum class Colors {
 	WindowBorderActive = 0,
 	WindowBorderInactive,
+	BarForeground,
+	BarBackground,
+	BarSelectedForeground,
+	BarSelectedBackground,
 };
 
 enum NetAtom { NetActiveWindow = 0,
     NetName,
     NetFullscreen,
-    NetState
+    NetState,
+    NetWMPid
 };
 
 enum Cursors {
@@ -57,6 +79,15 @@ struct Gaps {
     unsigned int out_v;
 };
 
+// Whether the processes of clients matching a rule get stopped while the
+// clients sit on tags nobody is viewing. Exempt wins over Freeze, so media
+// players can be left running while the rest of their kind is stopped.
+enum class FreezePolicy : uint8_t {
+    Unset,
+    Freeze,
+    Exempt,
+};
+
 struct Rule {
     const char* win_class;
     const char* win_instance;
@@ -66,12 +97,25 @@ struct Rule {
     bool is_terminal;
     bool no_swallow;
     bool monitor;
+    FreezePolicy freeze;
+};
+
+struct Scratchpad {
+    const char* name;
+    const char* command;
+    const char* win_class;    // nullptr matches any class
+    const char* win_instance; // nullptr matches any instance
+    float width;              // fraction of the monitor
+    float height;
 };
 
 struct Monitor {
     int screen;
 	float master_size;
     Util::Size<int> size;
+    unsigned int tags { 1 }; // bitmask of the tags being viewed
+    unsigned int master_count { 1 };
+    std::vector<Layout> layouts; // one per tag
 };
 
 struct WMProps {
@@ -88,6 +132,12 @@ public:
 
     void run();
 
+    // Re-executes the binary, handing the managed windows over to the new
+    // instance. Only returns if exec() failed.
+    void restart();
+
+    void set_argv(char**);
+
     ~WinMan();
 
     Display* display() const;
@@ -96,26 +146,100 @@ public:
     Atom wm_atom(WMAtom);
     Atom net_atom(NetAtom);
 
-    Client window_client_map_at(Window) const;
+    Client& window_client_map_at(Window);
     Cursor cursor(Cursors);
 
     Monitor monitor() const;
 
-    Client currently_focused() const;
+    // Null if nothing is focused.
+    Client* currently_focused();
+
+    const Settings& settings() const;
+
+    GeometryStore& geometry();
+
+    // Called by `Client::focus()`.
+    void focus_changed(Window);
+
+    void view_tags(unsigned int);
+    void toggle_tags(unsigned int);
+    void move_focused_to_tags(unsigned int);
+
+    void toggle_floating();
+    void cycle_layout(int);
+
+    // Focuses the window that many places back in the focus history of the
+    // viewed tags. While the binding's modifiers stay held the history isn't
+    // reordered, so pressing it again goes on further back; only the window
+    // it ends on when they're released is moved to the front.
+    void cycle_focus(int, unsigned int);
+    // Moves the focused window that many places along the tiling order.
+    void push_focused(int);
+
+    void toggle_scratchpad(const char*);
+
+    void toggle_overview();
+
+    // Starts a command, in a cgroup of its own if we manage any. -1 if fork()
+    // failed.
+    pid_t spawn(const char*);
+    // Logs how a spawned command ended, once it has.
+    Task watch_child(pid_t, std::string);
 
 private:
+    struct ScratchpadSlot {
+        const Scratchpad* config;
+        pid_t pid { -1 };
+        Window window { None };
+        bool visible { false };
+        unsigned int failures { 0 }; // deaths in a row before a window showed up
+        bool respawn_pending { false };
+    };
+
     WinMan(Display*);
 
     static int on_wm_detected(Display*, XErrorEvent*);
     static int on_x_error(Display*, XErrorEvent*);
-
+    // Both resume what we stopped before going down.
+    [[noreturn]] static int on_x_io_error(Display*);
+    [[noreturn]] static void on_fatal();
+
+    // Attributes the requests sent from here on, see `on_x_error()`.
+    void track(Window, const char*);
+    // Clients whose window turned out to be gone, found by the error handler
+    // which can't send requests itself.
+    void drop_gone_clients();
+
+    // Rebuilds everything that depends on the keyboard mapping.
+    void update_keymap();
     void grab_keys();
     void grab_buttons();
 
+    void adopt_windows();
+    void manage(const Client&);
+    void unmanage(Window);
+
+    void frame(Client&);
+    void unframe(Client&);
+
+    void spawn_scratchpad(ScratchpadSlot&);
+    Task schedule_scratchpad_respawn(ScratchpadSlot&);
+    bool scratchpad_waiting() const;
+    bool capture_scratchpad(const Client&, const char*, const char*);
+    void on_signals();
+    void reap_children();
+
+    void process_x_events();
+    void handle_event(XEvent&);
+
+    void reload_config();
+    void apply_settings(std::unique_ptr<Settings>);
+    void alloc_colors();
+
     void on_CreateNotify(const XCreateWindowEvent&);
     void on_DestroyNotify(const XDestroyWindowEvent&);
 
-    void on_MapRequest(const XMapRequestEvent&);
+    Task on_MapRequest(XMapRequestEvent);
     void on_MapNotify(const XMapEvent&);
 
     void on_UnmapNotify(const XUnmapEvent&);
@@ -124,6 +248,7 @@ private:
     void on_ConfigureNotify(const XConfigureEvent&);
 
     void on_KeyPress(const XKeyPressedEvent&);
+    void end_chord();
     void on_KeyRelease(const XKeyReleasedEvent&);
 
     void on_EnterNotify(const XEnterWindowEvent&);
@@ -134,17 +259,86 @@ private:
 
 	void on_MotionNotify(const XMotionEvent&);
 
+    void on_PropertyNotify(const XPropertyEvent&);
+    // Refetches the properties that changed since the last batch of events.
+    void fetch_properties();
+    void on_Expose(const XExposeEvent&);
+    void on_MappingNotify(XMappingEvent&);
+
+    void update_bar();
+    // Keys and clicks while the overview has the keyboard.
+    void overview_key(KeySym, unsigned int);
+    void overview_pick(Window);
+    // Resource usage of the focused client's cgroup.
+    void update_bar_usage();
+    void update_cgroups();
+    // Writes the state to the shared memory snapshot, if it changed.
+    void publish_snapshot();
+    void schedule_status_update();
+    void update_status();
+
     void tile();
+    LayoutParams layout_params() const;
+
+    // Stopping and resuming hidden clients' processes, see `FreezePolicy`.
+    bool should_freeze(const char*, const char*, const std::string&) const;
+    void schedule_freeze(Client&);
+    void cancel_freeze(Window);
+    void freeze(Window);
+    void thaw(pid_t);
+    void thaw_all();
+    // The one of the lowest viewed tag.
+    Layout& current_layout();
+    void restack();
+    void focus_under_pointer();
+    // The most recently focused window on the viewed tags.
+    void focus_most_recent();
+    void focus_client(Client&);
+    // Moves where the cycle ended up to the front of the history, or goes
+    // back to where it started.
+    void end_focus_cycle(bool);
+
+    // Marks everything sent so far as our own doing, see `on_EnterNotify()`.
+    void set_crossing_barrier();
 
 	XColor color(Colors) const;
 
     Display* m_display;
     const Window m_root_window;
 
+    // Same connection, for requests whose replies are awaited.
+    xcb_connection_t* m_xcb;
+    ReplyWaiters m_replies;
+    ChildWaiters m_children;
+    std::unordered_set<Window> m_pending_maps;
+
+    // Properties that changed, as `Client::Property` bits, and the windows
+    // whose last fetch isn't back yet.
+    std::unordered_map<Window, uint8_t> m_dirty_properties;
+    std::unordered_set<Window> m_fetching_properties;
+
+    RequestLog m_requests;
+
+    std::unordered_map<Window, EventLoop::TimerId> m_freeze_timers;
+    std::vector<Window> m_gone_windows;
+
     Monitor m_monitor;
 
-    std::vector<Client> m_stack;
+    GeometryStore m_geometry;
+
+    std::vector<Window> m_stack;
     std::unordered_map<Window, Client> m_window_to_client_map;
+
+    // Scratch space for `tile()`, kept around to not allocate every time.
+    std::vector<uint8_t> m_visible;
+    std::vector<Client*> m_tiled;
+    LayoutCache m_layouts;
+    std::vector<GeometryStore::Handle> m_stacking;
+    std::vector<Window> m_restack;
+
+    // Where the pointer was last seen, taken from the events that carry it so
+    // finding the window under it needs no round trip.
+    Position<int> m_pointer { 0, 0 };
     std::unordered_map<Cursors, Cursor> m_cursors;
 
     inline static bool m_wm_detected = false;
@@ -155,4 +349,64 @@ private:
 	Colormap m_colormap;
 
 	std::unordered_map<Colors, XColor> m_colors;
+
+    EventLoop m_loop;
+
+    // Property reads and such, so a slow client can't hold up the event loop.
+    std::unique_ptr<Worker> m_worker;
+
+    // Keysym of every keycode, without modifiers applied.
+    std::array<KeySym, 256> m_keysyms {};
+    unsigned int m_numlock_mask { 0 };
+    // The modifier bit every keycode sets, if any.
+    std::array<unsigned int, 256> m_modifiers {};
+    // Sorted, what is actually grabbed on the root window right now.
+    std::vector<std::pair<KeyCode, unsigned int>> m_key_grabs;
+    int m_xkb_event_base { -1 };
+
+    KeyTrie m_key_trie;
+    // Where in the trie the chord being typed is, the root when there's none.
+    unsigned int m_chord_node { KeyTrie::root };
+    EventLoop::TimerId m_chord_timer { 0 };
+
+    Window m_focused { None };
+
+    struct FocusCycle {
+        bool active { false };
+        // Releasing the last of these ends it.
+        unsigned int modmask { 0 };
+        GeometryStore::Handle origin { GeometryStore::invalid };
+        GeometryStore::Handle current { GeometryStore::invalid };
+    };
+    FocusCycle m_focus_cycle;
+
+    std::unique_ptr<FramePool> m_frame_pool;
+    std::unique_ptr<Overview> m_overview;
+    EventLoop::TimerId m_frame_refill_timer { 0 };
+
+    // Crossing events with a serial below this were caused by our own
+    // requests (restacking, moving windows under the pointer, ...).
+    unsigned long m_crossing_barrier_serial { 0 };
+    unsigned long m_suppressed_crossings { 0 };
+
+    // One per monitor, and there's only one monitor for now.
+    std::unique_ptr<Bar> m_bar;
+    Window m_bar_focused { None };
+    EventLoop::TimerId m_status_timer { 0 };
+    EventLoop::Clock::time_point m_last_status_update;
+
+    // Started at startup and kept unmapped, so toggling one only maps it.
+    std::vector<ScratchpadSlot> m_scratchpads;
+    int m_signal_fd { -1 };
+
+    std::string m_hostname;
+
+    Cgroups m_cgroups;
+    Snapshot::Writer m_snapshot;
+
+    char** m_argv { nullptr };
+
+    std::string m_config_path;
+    std::unique_ptr<Settings> m_settings;
+    std::unique_ptr<ConfigWatcher> m_config_watcher;
 };
@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <LibTrace.h>
+#include <LibWorker.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+Worker::Worker()
+    : m_display(CHECK_NOTNULL(XOpenDisplay(nullptr)))
+{
+    // Like the main connection, not to be inherited by spawned programs or
+    // the instance a restart execs into.
+    fcntl(ConnectionNumber(m_display), F_SETFD, FD_CLOEXEC);
+
+    m_job_fd = eventfd(0, EFD_CLOEXEC);
+    m_result_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    PCHECK(m_job_fd >= 0 && m_result_fd >= 0) << "eventfd() failed";
+
+    m_thread = std::thread([this] { run(); });
+}
+
+Worker::~Worker()
+{
+    m_stopping = true;
+    uint64_t one = 1;
+    write(m_job_fd, &one, sizeof(one));
+    m_thread.join();
+
+    close(m_job_fd);
+    close(m_result_fd);
+    XCloseDisplay(m_display);
+}
+
+int Worker::fd() const
+{
+    return m_result_fd;
+}
+
+Display* Worker::display() const
+{
+    return m_display;
+}
+
+bool Worker::post(Job job)
+{
+    if (m_pending >= capacity) {
+        LOG(WARNING) << "Worker has " << m_pending << " jobs in flight, dropping one";
+        return false;
+    }
+
+    CHECK(m_jobs.push(std::move(job)));
+    m_pending++;
+
+    uint64_t one = 1;
+    write(m_job_fd, &one, sizeof(one));
+    return true;
+}
+
+void Worker::drain()
+{
+    TRACE_SPAN("Worker::drain");
+
+    uint64_t count;
+    read(m_result_fd, &count, sizeof(count));
+
+    Result result;
+    while (m_results.pop(result)) {
+        m_pending--;
+        if (result)
+            result();
+    }
+}
+
+void Worker::run()
+{
+    Trace::register_thread("worker");
+
+    for (;;) {
+        uint64_t count;
+        if (read(m_job_fd, &count, sizeof(count)) < 0 && errno != EINTR) {
+            LOG(ERROR) << "Worker could not wait for jobs: " << strerror(errno) << " (errno=" << errno << ")";
+            return;
+        }
+
+        if (m_stopping)
+            return;
+
+        Job job;
+        bool produced = false;
+        while (m_jobs.pop(job)) {
+            TRACE_SPAN("Worker job");
+            m_results.push(job(m_display));
+            produced = true;
+        }
+
+        if (produced) {
+            uint64_t one = 1;
+            write(m_result_fd, &one, sizeof(one));
+        }
+    }
+}
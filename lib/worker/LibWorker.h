@@ -0,0 +1,96 @@
+/*
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <X11/Xlib.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+// Ring buffer for exactly one producer thread and one consumer thread.
+// Neither side ever blocks, `push()` fails when the buffer is full.
+template<typename T, size_t Capacity>
+class SpscQueue {
+public:
+    bool push(T&& value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        m_items[tail % Capacity] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        value = std::move(m_items[head % Capacity]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> m_items {};
+    // On separate cache lines so the two threads don't keep stealing one
+    // from each other.
+    alignas(64) std::atomic<size_t> m_head { 0 };
+    alignas(64) std::atomic<size_t> m_tail { 0 };
+};
+
+// A thread with its own X connection for work that may block: property
+// reads, anything under /proc, ... Jobs run in the order they were posted,
+// and each hands back a function that the main thread runs from `drain()`,
+// again in order.
+class Worker {
+public:
+    // Runs on the main thread, may be empty.
+    using Result = std::function<void()>;
+    // Runs on the worker thread, with the worker's connection.
+    using Job = std::function<Result(Display*)>;
+
+    static constexpr size_t capacity = 256;
+
+    Worker();
+    Worker(const Worker&) = delete;
+    Worker operator=(const Worker&) = delete;
+
+    ~Worker();
+
+    // An eventfd that becomes readable when there are results to drain.
+    int fd() const;
+
+    // Only fails when `capacity` jobs are already waiting or done but not
+    // drained yet.
+    bool post(Job);
+
+    // Runs the results of all finished jobs.
+    void drain();
+
+    Display* display() const;
+
+private:
+    void run();
+
+    Display* m_display;
+    int m_job_fd;
+    int m_result_fd;
+
+    SpscQueue<Job, capacity> m_jobs;
+    SpscQueue<Result, capacity> m_results;
+
+    // Posted but not drained yet, only touched by the main thread. Keeping
+    // it below the capacity means neither queue can ever be full.
+    size_t m_pending { 0 };
+
+    std::atomic<bool> m_stopping { false };
+    std::thread m_thread;
+};
@@ -0,0 +1,43 @@
+#! /bin/sh
+
+# Starts pluswm on its own Xvfb, runs the stress client against it and writes
+# the client's results, one JSON object, to $BENCH_OUTPUT, or stdout if that's
+# unset. Anything else (Xvfb's and pluswm's logging) goes to stderr. `make
+# bench` sets BENCH_OUTPUT, make prints its own progress on stdout.
+#
+#   bench.sh <pluswm> <stress-client> [windows] [windows per second] [kept open]
+
+set -e
+
+PLUSWM="$1"
+STRESS_CLIENT="$2"
+shift 2
+
+DISPLAY_NUMBER="${BENCH_DISPLAY_NUMBER:-99}"
+export DISPLAY=":$DISPLAY_NUMBER"
+
+Xvfb "$DISPLAY" -screen 0 1920x1080x24 -nolisten tcp >&2 &
+XVFB_PID=$!
+trap 'kill $WM_PID $XVFB_PID 2>/dev/null || true' EXIT
+
+i=0
+until [ -S "/tmp/.X11-unix/X$DISPLAY_NUMBER" ]; do
+	i=$((i + 1))
+	if [ $i -gt 50 ]; then
+		echo "Xvfb did not come up on $DISPLAY" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+# No config file of the user's, the numbers should only depend on the build.
+XDG_CONFIG_HOME="$(mktemp -d)" "$PLUSWM" >&2 &
+WM_PID=$!
+sleep 1
+
+if [ -n "$BENCH_OUTPUT" ]; then
+	"$STRESS_CLIENT" "$WM_PID" "$@" > "$BENCH_OUTPUT"
+	echo "Results written to $BENCH_OUTPUT" >&2
+else
+	"$STRESS_CLIENT" "$WM_PID" "$@"
+fi
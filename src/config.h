@@ -4,6 +4,9 @@
 #include <X11/X.h>
 #include <vector>
 
+/* Compiled in defaults. Most of these can be overridden at runtime through the
+ * config file, see lib/config/LibConfig.cpp for its syntax. */
+
 namespace Config {
 
 /* What key will be used as the Super key? */
@@ -20,12 +23,110 @@ static const unsigned int border_width_in_px = 5;
 static const Gaps gaps = Gaps(15, 15, 15, 15);
 static const bool smart_gaps = true;
 
+/* Give tiled windows the size closest to their spot that their size hints
+ * allow (e.g. whole character cells for terminals), which leaves small gaps */
+static const bool respect_size_hints = true;
+
+/* Proportion of the monitor taken up by the master area, between 0 and 1 */
+static const float master_size = 0.55;
+
+/* Give floating windows a frame with a title area */
+static const bool floating_frames = true;
+static const unsigned int frame_title_height_in_px = 16;
+/* Frames kept ready so framing a window doesn't have to create one */
+static const unsigned int frame_pool_size = 8;
+
+/* Layouts remembered, so going back to a recent window count or gap setting
+ * doesn't recompute the geometry */
+static const unsigned int layout_cache_size = 16;
+
+/* Layout every tag starts out with, `cycle_layout` goes through the others */
+static const Layout default_layout = Layout::Tile;
+
+/* Spans kept per thread when tracing (`PLUSWM_TRACE=/path/to/trace.json`,
+ * written on SIGUSR1), the oldest get overwritten */
+static const size_t trace_buffer_spans = 1 << 16;
+
+/* Every spawned command gets a cgroup (v2) of its own, so one can't starve
+ * the others or the window manager, and the bar shows what the focused one
+ * uses. Needs pluswm started in a group it may manage, see
+ * lib/cgroup/LibCgroup.h. Zero leaves a limit unset. */
+static const bool spawn_in_cgroups = true;
+static const unsigned int cgroup_wm_cpu_weight = 1000; /* the default is 100 */
+static const uint64_t cgroup_wm_memory_low = 64 << 20; /* bytes kept from reclaim */
+static const unsigned int cgroup_app_cpu_weight = 100;
+static const uint64_t cgroup_app_memory_high = 0; /* bytes, throttled above */
+static const uint64_t cgroup_app_memory_max = 0; /* bytes, OOM-killed above */
+static const unsigned int cgroup_stats_interval_in_ms = 2000;
+
+/* Keep a scaled down copy of every window for the overview (`toggle_overview`),
+ * which needs the Composite, Damage, XFixes and Render extensions. Costs the
+ * server a pixmap per window. */
+static const bool overview = true;
+static const int overview_thumbnail_size_in_px = 320;
+
+/* Keep a copy of the state (tags, clients, focus, layout) in shared memory,
+ * for bars and pagers to read without X round trips, see
+ * lib/snapshot/LibSnapshot.h */
+static const bool publish_snapshot = true;
+
+static const std::vector<const char*> tags = { "1", "2", "3", "4", "5", "6", "7", "8", "9" };
+
+static const bool show_bar = true;
+static const char* const bar_font = "-misc-fixed-medium-r-normal--13-*-*-*-*-*-iso8859-1";
+/* Minimum time between two redraws of the status text (set through the root
+ * window name, e.g. `xsetroot -name`). */
+static const unsigned int bar_status_interval_in_ms = 500;
+
 static const std::vector<Rule> rules = {};
 
+/* How long a client has to sit on hidden tags before its process is stopped,
+ * if a rule says `freeze=true` for it (and none `freeze=false`). It's resumed
+ * as soon as one of its tags is viewed again. */
+static const unsigned int freeze_hidden_after_in_ms = 30000;
+
+/* Started once at startup and kept hidden until toggled. Windows are picked up
+ * by WM_CLASS, so give the command a class/instance nothing else uses. */
+static const std::vector<Scratchpad> scratchpads = {
+    /* name     command                    class    instance       width height */
+    { "term", "xterm -name scratchpad", nullptr, "scratchpad", 0.6, 0.5 },
+};
+
+#define TAGKEYS(KEY, TAG)                                                         \
+    { modkey, KEY, KeyAction::TagView, { .ui = 1 << TAG } },                      \
+    { modkey | ControlMask, KEY, KeyAction::TagToggle, { .ui = 1 << TAG } },      \
+    { modkey | ShiftMask, KEY, KeyAction::TagMoveTo, { .ui = 1 << TAG } },
+
+// How long to wait for the next key of a chord before giving up on it.
+static const unsigned int chord_timeout_in_ms = 1500;
+
 static const std::vector<Keybind> keybinds = {
     { modkey, XK_p, KeyAction::Spawn, { .s = "echo" } },
     { modkey, XK_q, KeyAction::KillClient, { .v = nullptr } },
 	{ modkey, XK_f, KeyAction::ToggleFullscreen, { .v = nullptr } },
+	{ modkey | ShiftMask, XK_r, KeyAction::Restart, { .v = nullptr } },
+	{ modkey | ShiftMask, XK_space, KeyAction::ToggleFloat, { .v = nullptr } },
+	{ modkey, XK_grave, KeyAction::ToggleScratchpad, { .s = "term" } },
+	{ modkey, XK_space, KeyAction::CycleLayout, { .i = 1 } },
+	{ modkey | ControlMask, XK_space, KeyAction::CycleLayout, { .i = -1 } },
+	{ modkey, XK_o, KeyAction::ToggleOverview, { .v = nullptr } },
+	// back through the focus history for as long as modkey is held
+	{ modkey, XK_Tab, KeyAction::StackFocus, { .i = 1 } },
+	{ modkey | ShiftMask, XK_Tab, KeyAction::StackFocus, { .i = -1 } },
+	{ modkey | ShiftMask, XK_j, KeyAction::StackPush, { .i = 1 } },
+	{ modkey | ShiftMask, XK_k, KeyAction::StackPush, { .i = -1 } },
+	// chords: Mod+x, then the second key
+	{ modkey, XK_x, { { nomod, XK_f } }, KeyAction::ToggleFloat, { .v = nullptr } },
+	{ modkey, XK_x, { { nomod, XK_s } }, KeyAction::ToggleScratchpad, { .s = "term" } },
+    TAGKEYS(XK_1, 0)
+    TAGKEYS(XK_2, 1)
+    TAGKEYS(XK_3, 2)
+    TAGKEYS(XK_4, 3)
+    TAGKEYS(XK_5, 4)
+    TAGKEYS(XK_6, 5)
+    TAGKEYS(XK_7, 6)
+    TAGKEYS(XK_8, 7)
+    TAGKEYS(XK_9, 8)
 };
 
 
@@ -35,7 +136,11 @@ static const std::vector<Button> buttons = {
 
 static const std::map<Colors, const char*> colors = {
 	{ Colors::WindowBorderActive, "#689d6a" },
-	{ Colors::WindowBorderInactive, "#1d2021" }
+	{ Colors::WindowBorderInactive, "#1d2021" },
+	{ Colors::BarForeground, "#a89984" },
+	{ Colors::BarBackground, "#1d2021" },
+	{ Colors::BarSelectedForeground, "#ebdbb2" },
+	{ Colors::BarSelectedBackground, "#427b58" },
 };
 
 }
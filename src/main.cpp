@@ -20,8 +20,13 @@ int main(int argc, char** argv)
         return EXIT_SUCCESS;
     }
 
+    // The window manager and its worker thread each have a connection.
+    XInitThreads();
+
     auto& wm = WinMan::get();
 
+    wm.set_argv(argv);
+
     wm.run();
 
     return EXIT_SUCCESS;